@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/device.h>
+
+#if defined(CONFIG_ZMK_SCROLL_SNAP_BENCHMARK)
+// enum scroll_snap_path
+#include <scroll_snap/scroll_snap_core.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// One motion delta, as read from a sensor burst
+struct scroll_snap_delta {
+    int32_t dx;
+    int32_t dy;
+};
+
+/**
+ * Snap a burst of motion deltas with a single decision.
+ *
+ * The deltas are summed and run through the instance's window and snap decision once, as one
+ * frame. The snapped motion is returned in @p dx and @p dy for the caller to report; no input
+ * events are generated. An instance should be fed either through this call or through an input
+ * listener, not both.
+ *
+ * @param dev    Scroll snap input processor instance.
+ * @param deltas Deltas of the burst, oldest first.
+ * @param count  Number of deltas.
+ * @param dx     Snapped x motion.
+ * @param dy     Snapped y motion.
+ *
+ * @retval 0 on success, with the snapped motion in @p dx and @p dy.
+ * @retval -EAGAIN if the motion was held back, e.g. while collecting samples.
+ * @retval -EINVAL if @p count is 0.
+ */
+int zmk_scroll_snap_process_burst(const struct device *dev, const struct scroll_snap_delta *deltas,
+                                  size_t count, int32_t *dx, int32_t *dy);
+
+// Parameters of an instance that can be changed at runtime, in devicetree units.
+// Requires CONFIG_ZMK_SCROLL_SNAP_RUNTIME_TUNING.
+struct zmk_scroll_snap_tuning {
+    uint32_t x_threshold[2];
+    uint32_t y_threshold[2];
+    uint32_t xy_threshold[2];
+    uint32_t require_n_samples;
+    uint32_t immediate_snap_threshold;
+    uint32_t lock_duration_ms;
+    uint32_t lock_for_next_n_events;
+    uint32_t idle_reset_timeout_ms;
+};
+
+/**
+ * Read the current parameters of an instance.
+ *
+ * @retval 0 on success.
+ */
+int zmk_scroll_snap_get_tuning(const struct device *dev, struct zmk_scroll_snap_tuning *tuning);
+
+/**
+ * Replace the parameters of an instance. The new set takes effect as a whole with the next
+ * event; changing require_n_samples restarts sample collection.
+ *
+ * @retval 0 on success.
+ * @retval -EINVAL if a parameter is out of range.
+ * @retval -ENOTSUP if the thresholds differ from devicetree on an instance with
+ *         classifier = "lut", whose table is generated from them at build time.
+ */
+int zmk_scroll_snap_set_tuning(const struct device *dev,
+                               const struct zmk_scroll_snap_tuning *tuning);
+
+/**
+ * Restore the devicetree parameters of an instance.
+ *
+ * @retval 0 on success.
+ */
+int zmk_scroll_snap_reset_tuning(const struct device *dev);
+
+#if defined(CONFIG_ZMK_SCROLL_SNAP_BENCHMARK)
+/**
+ * Read the path the last event of an instance took and its cycle count, as measured for the
+ * benchmark report. Events of other types or codes report SCROLL_SNAP_PATH_IGNORED.
+ * Requires CONFIG_ZMK_SCROLL_SNAP_BENCHMARK.
+ *
+ * @retval 0 on success.
+ */
+int zmk_scroll_snap_bench_last(const struct device *dev, enum scroll_snap_path *path,
+                               uint32_t *cycles);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
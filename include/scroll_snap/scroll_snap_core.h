@@ -0,0 +1,1290 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+/*
+ * Platform-independent scroll snap decision core.
+ *
+ * Everything here is plain C on top of the standard headers, so the firmware and the host replay
+ * tool (tools/replay) run the same code. The functions are static inline so the firmware can
+ * still specialize them per instance against a const parameter block.
+ *
+ * Build options are read as plain CONFIG_ZMK_SCROLL_SNAP_* defines: Kconfig provides them on the
+ * target, the host build passes them with -D.
+ *
+ * An includer that wants statistics or direction logging defines SCROLL_SNAP_CORE_HOOKS before
+ * including this header and implements scroll_snap_core_count() and scroll_snap_core_decided().
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifndef MIN
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+#ifndef CLAMP
+#define CLAMP(val, low, high) (((val) <= (low)) ? (low) : MIN(val, high))
+#endif
+#ifndef ALWAYS_INLINE
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+#endif
+
+// Constant-expression ceil(log2(x)), usable in array sizes
+#define SCROLL_SNAP_LOG2CEIL(x) ((x) <= 1 ? 0 : 32 - __builtin_clz((uint32_t)(x) - 1))
+
+struct scroll_snap_sample {
+    int32_t dx;
+    int32_t dy;
+};
+
+#if defined(CONFIG_ZMK_SCROLL_SNAP_SAMPLE_STORAGE_PACKED)
+// Only magnitudes enter the sums, so a slot is a saturated magnitude plus an axis bit
+typedef uint16_t scroll_snap_slot_t;
+#define SCROLL_SNAP_SLOT_AXIS_Y (1U << 15)
+#define SCROLL_SNAP_SLOT_MAGNITUDE_MAX (SCROLL_SNAP_SLOT_AXIS_Y - 1)
+#else
+typedef struct scroll_snap_sample scroll_snap_slot_t;
+#endif
+
+#define DIRECTION_NONE 0
+#define DIRECTION_X 1
+#define DIRECTION_Y 2
+#define DIRECTION_DIAG_PLUS 3
+#define DIRECTION_DIAG_MINUS 4
+
+#if defined(CONFIG_ZMK_SCROLL_SNAP_RING_POW2)
+// Ring sizes are rounded up to a power of two so the window advance is a mask
+#define SCROLL_SNAP_RING_SIZE(n) (1U << SCROLL_SNAP_LOG2CEIL(n))
+#else
+#define SCROLL_SNAP_RING_SIZE(n) (n)
+#endif
+
+#if defined(CONFIG_ZMK_SCROLL_SNAP_ACCUMULATOR_16BIT)
+// Saturated 16-bit magnitudes: threshold products fit a single 32-bit multiply
+typedef uint16_t scroll_snap_mag_t;
+typedef uint32_t scroll_snap_prod_t;
+#define SCROLL_SNAP_MAG_MAX UINT16_MAX
+#else
+// 32-bit magnitudes: threshold products are widened to 64 bits
+typedef uint32_t scroll_snap_mag_t;
+typedef uint64_t scroll_snap_prod_t;
+#define SCROLL_SNAP_MAG_MAX UINT32_MAX
+#endif
+
+// Time source ticks, compared by difference only. 32-bit ticks are wrap-safe while times are
+// less than 2^31 ticks apart. The cycle counter uses 64-bit ticks, as a fast counter wraps
+// 32 bits within a minute; durations stay 32-bit.
+#if defined(CONFIG_ZMK_SCROLL_SNAP_TIME_SOURCE_CYCLES)
+typedef uint64_t scroll_snap_time_t;
+typedef int64_t scroll_snap_time_diff_t;
+#else
+typedef uint32_t scroll_snap_time_t;
+typedef int32_t scroll_snap_time_diff_t;
+#endif
+
+// True if time a is at or after time b
+static inline bool scroll_snap_time_reached(scroll_snap_time_t a, scroll_snap_time_t b) {
+    return (scroll_snap_time_diff_t)(a - b) >= 0;
+}
+
+// Ticks from then to now, saturated to the width of the durations
+static inline uint32_t scroll_snap_elapsed(scroll_snap_time_t now, scroll_snap_time_t then) {
+#if defined(CONFIG_ZMK_SCROLL_SNAP_TIME_SOURCE_CYCLES)
+    return (uint32_t)MIN(now - then, UINT32_MAX);
+#else
+    return now - then;
+#endif
+}
+
+#define SCROLL_SNAP_ESTIMATOR_WINDOW 0
+#define SCROLL_SNAP_ESTIMATOR_EMA 1
+
+// EMA sums are kept in fixed point so the decay keeps working at small magnitudes
+#define SCROLL_SNAP_EMA_FRAC_BITS 8
+#define SCROLL_SNAP_EMA_MAX_WINDOW 4096
+
+// Derived parameters, shared by the devicetree instances and the replay tool
+#define SCROLL_SNAP_EMA_SHIFT(window) SCROLL_SNAP_LOG2CEIL(window)
+#define SCROLL_SNAP_EMA_MAGNITUDE_MAX(window)                                                           \
+    (INT32_MAX >> (SCROLL_SNAP_EMA_FRAC_BITS + SCROLL_SNAP_EMA_SHIFT(window)))
+#define SCROLL_SNAP_WINDOW_RECIP(ticks)                                                                 \
+    ((uint32_t)MIN((1ULL << 32) / MAX((uint64_t)(ticks), 1ULL), (uint64_t)UINT32_MAX))
+// Velocity adaptation: 8.16 reciprocal of velocity-fast, and the factor applied to off-axis
+// magnitudes at full speed, in 1/256 steps
+#define SCROLL_SNAP_VELOCITY_RECIP(fast) ((uint32_t)((1U << 24) / MAX((uint32_t)(fast), 1U)))
+#define SCROLL_SNAP_VELOCITY_OFF_AXIS_Q8(scale_pct) ((uint16_t)(25600U / MAX((uint32_t)(scale_pct), 100U)))
+// Output step: the shift of a power-of-two step, 0 otherwise, and the 0.32 reciprocal of
+// other steps, rounded up
+#define SCROLL_SNAP_STEP_SHIFT(step)                                                                    \
+    ((step) > 1 && ((step) & ((step) - 1)) == 0 ? SCROLL_SNAP_LOG2CEIL(step) : 0)
+#define SCROLL_SNAP_STEP_RECIP(step)                                                                    \
+    ((step) > 1 ? (uint32_t)((0xffffffffULL + (step)) / (step)) : 0)
+
+// Most samples a window counts, the upper bound of ZMK_SCROLL_SNAP_MAX_BUF_SIZE
+#define SCROLL_SNAP_SAMPLES_MAX 64
+// Largest magnitude a sample adds to the window sums, so a full window of them cannot overflow
+// the int32 sums
+#define SCROLL_SNAP_SAMPLE_MAGNITUDE_MAX (INT32_MAX / SCROLL_SNAP_SAMPLES_MAX)
+// Rounded-up 0.15 reciprocals of the sample counts, so the mean magnitude of a partly filled
+// window needs no division. The mean comes out at most 0.2% high, well below the velocity steps.
+#define SCROLL_SNAP_COUNT_RECIP(c) ((c) == 0 ? 0 : (uint16_t)((32768U + (c) - 1) / (c)))
+#define SCROLL_SNAP_COUNT_RECIP4(c)                                                                     \
+    SCROLL_SNAP_COUNT_RECIP(c), SCROLL_SNAP_COUNT_RECIP((c) + 1), SCROLL_SNAP_COUNT_RECIP((c) + 2),     \
+        SCROLL_SNAP_COUNT_RECIP((c) + 3)
+#define SCROLL_SNAP_COUNT_RECIP16(c)                                                                    \
+    SCROLL_SNAP_COUNT_RECIP4(c), SCROLL_SNAP_COUNT_RECIP4((c) + 4), SCROLL_SNAP_COUNT_RECIP4((c) + 8),  \
+        SCROLL_SNAP_COUNT_RECIP4((c) + 12)
+
+static const uint16_t scroll_snap_count_recip[SCROLL_SNAP_SAMPLES_MAX + 1] = {
+    SCROLL_SNAP_COUNT_RECIP16(0), SCROLL_SNAP_COUNT_RECIP16(16), SCROLL_SNAP_COUNT_RECIP16(32),
+    SCROLL_SNAP_COUNT_RECIP16(48), SCROLL_SNAP_COUNT_RECIP(64)};
+
+// Direction LUT classifier: magnitudes are compared by their log2 ratio in 1/16 octave steps,
+// the LUT maps each step within +-8 octaves to a direction. SCROLL_SNAP_LUT_SIZE is spelled out
+// for LISTIFY().
+#define SCROLL_SNAP_LUT_RANGE 128
+#define SCROLL_SNAP_LUT_SIZE 257
+
+// log2 in 1/16 octaves from the top four mantissa bits, rounded at the bucket midpoint:
+// fraction minus one per mantissa, four bits each
+#define SCROLL_SNAP_LOG2_FRAC_LO 0x87654210U
+#define SCROLL_SNAP_LOG2_FRAC_HI 0xfedccba9U
+#define SCROLL_SNAP_LOG2_MSB(v) (31 - __builtin_clz((uint32_t)(v)))
+#define SCROLL_SNAP_LOG2_MANT(v)                                                                        \
+    ((SCROLL_SNAP_LOG2_MSB(v) >= 4 ? (uint32_t)(v) >> (SCROLL_SNAP_LOG2_MSB(v) - 4)                     \
+                                   : (uint32_t)(v) << (4 - SCROLL_SNAP_LOG2_MSB(v))) &                  \
+     15)
+#define SCROLL_SNAP_LOG2_FRAC(m)                                                                        \
+    (((((m) & 8) ? SCROLL_SNAP_LOG2_FRAC_HI : SCROLL_SNAP_LOG2_FRAC_LO) >> (4 * ((m) & 7)) & 15) + 1)
+// Only defined for v > 0
+#define SCROLL_SNAP_LOG2_Q4(v)                                                                          \
+    ((int32_t)(SCROLL_SNAP_LOG2_MSB(v) * 16 + SCROLL_SNAP_LOG2_FRAC(SCROLL_SNAP_LOG2_MANT(v))))
+
+// Log ratio a/b at which a threshold test a*y < b*x flips. A zero term makes the test pass or
+// fail for every ratio, both zero terms select never_ratio. SCROLL_SNAP_LUT_BEYOND lies past
+// every bucket and every bound of nonzero terms.
+#define SCROLL_SNAP_LUT_BEYOND 1024
+#define SCROLL_SNAP_LUT_BOUND(a, b, never_ratio)                                                        \
+    ((a) == 0 && (b) == 0 ? (never_ratio)                                                               \
+     : (a) == 0           ? -SCROLL_SNAP_LUT_BEYOND                                                     \
+     : (b) == 0           ? SCROLL_SNAP_LUT_BEYOND                                                      \
+                          : SCROLL_SNAP_LOG2_Q4(a) - SCROLL_SNAP_LOG2_Q4(b))
+#define SCROLL_SNAP_LUT_Y_BOUND(y_num, y_den)                                                           \
+    SCROLL_SNAP_LUT_BOUND(y_num, y_den, SCROLL_SNAP_LUT_BEYOND)
+#define SCROLL_SNAP_LUT_X_BOUND(x_num, x_den)                                                           \
+    SCROLL_SNAP_LUT_BOUND(x_num, x_den, -SCROLL_SNAP_LUT_BEYOND)
+#define SCROLL_SNAP_LUT_XY_LOW(xy_num, xy_den)                                                          \
+    SCROLL_SNAP_LUT_BOUND(xy_num, xy_den, SCROLL_SNAP_LUT_BEYOND)
+#define SCROLL_SNAP_LUT_XY_HIGH(xy_num, xy_den)                                                         \
+    SCROLL_SNAP_LUT_BOUND(xy_den, xy_num, -SCROLL_SNAP_LUT_BEYOND)
+
+// Entry of buckets that need the threshold tests. SCROLL_SNAP_LOG2_Q4() is less than one step
+// off 16 * log2, so a bucket and a bound are each less than two steps off the exact log ratio
+// of their terms: a bucket within SCROLL_SNAP_LUT_MARGIN steps of a bound may hold ratios on
+// both sides of it. The outer buckets also hold all ratios clamped into them.
+#define SCROLL_SNAP_LUT_EXACT 0xff
+#define SCROLL_SNAP_LUT_MARGIN 3
+#define SCROLL_SNAP_LUT_NEAR(q, bound)                                                                  \
+    ((bound) > -SCROLL_SNAP_LUT_BEYOND && (bound) < SCROLL_SNAP_LUT_BEYOND &&                           \
+     ((q) - SCROLL_SNAP_LUT_MARGIN <= (bound) || (q) == -SCROLL_SNAP_LUT_RANGE) &&                      \
+     ((q) + SCROLL_SNAP_LUT_MARGIN >= (bound) || (q) == SCROLL_SNAP_LUT_RANGE))
+
+// Direction of LUT entry i, in the order scroll_snap_detect() tests the thresholds, so every
+// entry other than SCROLL_SNAP_LUT_EXACT gives the result of the threshold tests for all ratios
+// in its bucket. Diagonal entries are DIRECTION_DIAG_PLUS; the sign is resolved per event.
+#define SCROLL_SNAP_LUT_Q(i) ((int32_t)(i) - SCROLL_SNAP_LUT_RANGE)
+#define SCROLL_SNAP_LUT_ENTRY(i, x_bound, y_bound, xy_low, xy_high)                                     \
+    (SCROLL_SNAP_LUT_NEAR(SCROLL_SNAP_LUT_Q(i), y_bound) ||                                             \
+             SCROLL_SNAP_LUT_NEAR(SCROLL_SNAP_LUT_Q(i), x_bound) ||                                     \
+             SCROLL_SNAP_LUT_NEAR(SCROLL_SNAP_LUT_Q(i), xy_low) ||                                      \
+             SCROLL_SNAP_LUT_NEAR(SCROLL_SNAP_LUT_Q(i), xy_high)                                        \
+         ? SCROLL_SNAP_LUT_EXACT                                                                        \
+     : SCROLL_SNAP_LUT_Q(i) > (y_bound) ? DIRECTION_Y                                                   \
+     : SCROLL_SNAP_LUT_Q(i) < (x_bound) ? DIRECTION_X                                                   \
+     : (SCROLL_SNAP_LUT_Q(i) > (xy_low) && SCROLL_SNAP_LUT_Q(i) < (xy_high))                            \
+         ? DIRECTION_DIAG_PLUS                                                                          \
+         : DIRECTION_NONE)
+
+// Path taken by an event through the handler, used to classify benchmark samples
+enum scroll_snap_path {
+    SCROLL_SNAP_PATH_IGNORED,
+    SCROLL_SNAP_PATH_ACCUMULATE,
+    SCROLL_SNAP_PATH_DECIDE,
+    SCROLL_SNAP_PATH_LOCKED,
+    SCROLL_SNAP_PATH_FAST,
+    SCROLL_SNAP_PATH_COUNT,
+};
+
+// Counters reported through scroll_snap_core_count()
+enum scroll_snap_stat {
+    SCROLL_SNAP_STAT_SNAP_X,
+    SCROLL_SNAP_STAT_SNAP_Y,
+    SCROLL_SNAP_STAT_SNAP_DIAG,
+    SCROLL_SNAP_STAT_SNAP_NONE,
+    SCROLL_SNAP_STAT_IMMEDIATE_SNAPS,
+    SCROLL_SNAP_STAT_WARMUP_SWALLOWED,
+    SCROLL_SNAP_STAT_SPECULATIVE_SNAPS,
+    SCROLL_SNAP_STAT_SPECULATION_REVISED,
+    SCROLL_SNAP_STAT_ZERO_SUPPRESSED,
+    SCROLL_SNAP_STAT_LOCKS_STARTED,
+    SCROLL_SNAP_STAT_LOCKED_EVENTS,
+    SCROLL_SNAP_STAT_LOCK_HELD_TICKS,
+    SCROLL_SNAP_STAT_COUNT,
+};
+
+// Decision state of one instance
+struct scroll_snap_core {
+    uint16_t head;
+    uint16_t sample_count;
+    struct scroll_snap_sample sample_sum;
+
+    struct scroll_snap_sample remainder;
+    // Projected diagonal motion not yet emitted on its axis
+    struct scroll_snap_sample diag_owed;
+    // Snapped motion short of a whole output step, emitted once it adds up to one
+    struct scroll_snap_sample output_pending;
+    // Sign of the last non-zero value per axis, to tell the two diagonals apart
+    bool negative_x;
+    bool negative_y;
+    // A non-zero value was forwarded in the current frame and still needs its sync
+    bool frame_emitted;
+    // Events were held back while collecting samples, and their motion was not emitted yet
+    bool warmup_held;
+
+    scroll_snap_time_t last_event_ts;
+    scroll_snap_time_t window_start;
+    bool window_open;
+    // Axis emitted speculatively while collecting samples, or DIRECTION_NONE
+    uint8_t guess_direction;
+    uint8_t lock_direction;
+    uint16_t lock_events_remaining;
+    scroll_snap_time_t lock_expires_at;
+    scroll_snap_time_t lock_started_at;
+};
+
+#if defined(CONFIG_ZMK_SCROLL_SNAP_RUNTIME_TUNING)
+// Parameters that can change at runtime, in the form the core reads them. Durations are in time
+// source ticks and require_n_samples is the ring size, as in struct scroll_snap_params.
+struct scroll_snap_tuned {
+    uint32_t x_thresh_num;
+    uint32_t x_thresh_den;
+    uint32_t y_thresh_num;
+    uint32_t y_thresh_den;
+    uint32_t xy_thresh_num;
+    uint32_t xy_thresh_den;
+    uint32_t immediate_snap_threshold;
+    uint32_t lock_duration;
+    uint32_t idle_reset_timeout;
+    uint16_t require_n_samples;
+    uint16_t velocity_fast_samples;
+    uint16_t lock_for_next_n_events;
+    bool uses_time;
+};
+
+// Tunable parameters are read from the overlay; everything else stays a constant the compiler
+// can fold into per-instance handlers
+#define SCROLL_SNAP_TUNED(params, field) ((params)->tuned->field)
+#else
+#define SCROLL_SNAP_TUNED(params, field) ((params)->field)
+#endif
+
+// Tuning of one instance. Durations are in time source ticks. With runtime tuning, the fields of
+// struct scroll_snap_tuned hold the devicetree values and are read through tuned instead.
+struct scroll_snap_params {
+    uint32_t x_thresh_num;
+    uint32_t x_thresh_den;
+    uint32_t y_thresh_num;
+    uint32_t y_thresh_den;
+    uint32_t xy_thresh_num;
+    uint32_t xy_thresh_den;
+    // Direction LUT of SCROLL_SNAP_LUT_SIZE entries replacing the threshold tests, or NULL
+    const uint8_t *direction_lut;
+
+    uint8_t estimator;
+    scroll_snap_slot_t *samples;
+    uint16_t require_n_samples;
+    uint8_t ema_shift;
+    uint32_t ema_magnitude_max;
+    uint32_t sample_window;
+    uint32_t sample_window_recip;
+    scroll_snap_time_t *sample_ts;
+    uint32_t immediate_snap_threshold;
+    // Speculative snap while collecting samples, disabled if speculative_num is 0
+    uint32_t speculative_num;
+    uint32_t speculative_den;
+    // Velocity adaptation, disabled if velocity_fast is 0
+    uint32_t velocity_fast;
+    uint32_t velocity_fast_recip;
+    uint16_t velocity_fast_samples;
+    uint16_t velocity_off_axis_q8;
+    // Hysteresis hold of a snapped axis, disabled if hysteresis_num is 0
+    uint32_t hysteresis_num;
+    uint32_t hysteresis_den;
+    uint32_t lock_duration;
+    uint16_t lock_for_next_n_events;
+    // Skip detection while a held lock cannot need a refresh, see scroll_snap_lock_fast_path()
+    bool lock_fast_path;
+    uint32_t idle_reset_timeout;
+    // Whether any time-based feature is enabled, i.e. whether the time source is read at all
+    bool uses_time;
+
+    bool coalesce_frames;
+    bool suppress_zero_events;
+    bool track_remainders;
+    // Emit snapped motion in whole multiples of this, disabled if 0 or 1
+    uint32_t output_step;
+    uint8_t output_step_shift;
+    uint32_t output_step_recip;
+#if defined(CONFIG_ZMK_SCROLL_SNAP_RUNTIME_TUNING)
+    // Current runtime values of the tunable parameters, owned by the event path
+    const struct scroll_snap_tuned *tuned;
+#endif
+};
+
+// Derivation of struct scroll_snap_params from an instance configuration in devicetree units,
+// shared by the devicetree instances and the replay tool. prop(src, name) yields a property and
+// prop_idx(src, name, idx) one cell of an array property, both 0 if unset; names are the
+// devicetree property names with underscores.
+#define SCROLL_SNAP_PARAMS_N_SAMPLES(prop, src, max_samples)                                            \
+    CLAMP(prop(src, require_n_samples), 1, max_samples)
+
+#define SCROLL_SNAP_PARAMS_EMA_WINDOW(prop, src)                                                        \
+    CLAMP(prop(src, ema_window) ? prop(src, ema_window) : prop(src, require_n_samples), 1,              \
+          SCROLL_SNAP_EMA_MAX_WINDOW)
+
+// The hysteresis hold replaces the lock timers, which are then ignored
+#define SCROLL_SNAP_PARAMS_HAS_HYSTERESIS(prop_idx, src) (prop_idx(src, hysteresis_threshold, 0) > 0)
+
+#define SCROLL_SNAP_PARAMS_LOCK(prop, prop_idx, src, name)                                              \
+    (SCROLL_SNAP_PARAMS_HAS_HYSTERESIS(prop_idx, src) ? 0 : prop(src, name))
+
+// Initializer of struct scroll_snap_params. is_ema tells whether estimator = "ema", to_ticks
+// converts milliseconds to time source ticks. The caller provides the sample ring, the timestamp
+// ring and the direction LUT, or NULL where it has none; initializers of further fields follow in
+// the variable arguments.
+#define SCROLL_SNAP_PARAMS_INIT(prop, prop_idx, src, is_ema, max_samples, to_ticks, samples_,           \
+                                sample_ts_, lut, lock_fast_path_, ...)                                  \
+    {                                                                                                   \
+        .x_thresh_num = prop_idx(src, x_threshold, 0),                                                  \
+        .x_thresh_den = prop_idx(src, x_threshold, 1),                                                  \
+        .y_thresh_num = prop_idx(src, y_threshold, 0),                                                  \
+        .y_thresh_den = prop_idx(src, y_threshold, 1),                                                  \
+        .xy_thresh_num = prop_idx(src, xy_threshold, 0),                                                \
+        .xy_thresh_den = prop_idx(src, xy_threshold, 1),                                                \
+        .direction_lut = (lut),                                                                         \
+        .estimator = (is_ema) ? SCROLL_SNAP_ESTIMATOR_EMA : SCROLL_SNAP_ESTIMATOR_WINDOW,               \
+        .samples = (is_ema) ? NULL : (samples_),                                                        \
+        .require_n_samples = (is_ema) ? SCROLL_SNAP_PARAMS_N_SAMPLES(prop, src, max_samples)            \
+                                      : SCROLL_SNAP_RING_SIZE(                                          \
+                                            SCROLL_SNAP_PARAMS_N_SAMPLES(prop, src, max_samples)),      \
+        .ema_shift = SCROLL_SNAP_EMA_SHIFT(SCROLL_SNAP_PARAMS_EMA_WINDOW(prop, src)),                   \
+        .ema_magnitude_max = SCROLL_SNAP_EMA_MAGNITUDE_MAX(SCROLL_SNAP_PARAMS_EMA_WINDOW(prop, src)),   \
+        .sample_window = to_ticks(prop(src, sample_window_ms)),                                         \
+        .sample_window_recip = SCROLL_SNAP_WINDOW_RECIP(to_ticks(prop(src, sample_window_ms))),         \
+        .sample_ts = !(is_ema) && prop(src, sample_window_ms) > 0 ? (sample_ts_) : NULL,                \
+        .immediate_snap_threshold = prop(src, immediate_snap_threshold),                                \
+        .speculative_num = prop_idx(src, speculative_threshold, 0),                                     \
+        .speculative_den = prop_idx(src, speculative_threshold, 1),                                     \
+        .velocity_fast = prop(src, velocity_fast),                                                      \
+        .velocity_fast_recip = SCROLL_SNAP_VELOCITY_RECIP(prop(src, velocity_fast)),                    \
+        .velocity_fast_samples = CLAMP(prop(src, velocity_fast_samples), 1,                             \
+                                       SCROLL_SNAP_PARAMS_N_SAMPLES(prop, src, max_samples)),           \
+        .velocity_off_axis_q8 =                                                                         \
+            SCROLL_SNAP_VELOCITY_OFF_AXIS_Q8(prop(src, velocity_fast_threshold_scale)),                 \
+        .hysteresis_num = prop_idx(src, hysteresis_threshold, 0),                                       \
+        .hysteresis_den = prop_idx(src, hysteresis_threshold, 1),                                       \
+        .lock_duration = to_ticks(SCROLL_SNAP_PARAMS_LOCK(prop, prop_idx, src, lock_duration_ms)),      \
+        .lock_for_next_n_events =                                                                       \
+            SCROLL_SNAP_PARAMS_LOCK(prop, prop_idx, src, lock_for_next_n_events),                       \
+        .lock_fast_path = (lock_fast_path_),                                                            \
+        .idle_reset_timeout = to_ticks(prop(src, idle_reset_timeout_ms)),                               \
+        .uses_time = prop(src, idle_reset_timeout_ms) > 0 || prop(src, sample_window_ms) > 0 ||         \
+                     SCROLL_SNAP_PARAMS_LOCK(prop, prop_idx, src, lock_duration_ms) > 0,                \
+        .coalesce_frames = prop(src, coalesce_frames),                                                  \
+        .suppress_zero_events = prop(src, suppress_zero_events),                                        \
+        .track_remainders = prop(src, track_remainders),                                                \
+        .output_step = prop(src, output_step),                                                          \
+        .output_step_shift = SCROLL_SNAP_STEP_SHIFT(prop(src, output_step)),                            \
+        .output_step_recip = SCROLL_SNAP_STEP_RECIP(prop(src, output_step)),                            \
+        __VA_ARGS__                                                                                     \
+    }
+
+// One value on one of the two configured axes. The core may rewrite all three fields.
+struct scroll_snap_event {
+    int32_t value;
+    bool is_x_axis;
+    bool sync;
+};
+
+#if defined(SCROLL_SNAP_CORE_HOOKS)
+// Implemented by the includer
+static inline void scroll_snap_core_count(struct scroll_snap_core *core, enum scroll_snap_stat stat,
+                                          uint32_t n);
+static inline void scroll_snap_core_decided(struct scroll_snap_core *core, uint8_t direction);
+#else
+static inline void scroll_snap_core_count(struct scroll_snap_core *core, enum scroll_snap_stat stat,
+                                          uint32_t n) {
+    (void)core;
+    (void)stat;
+    (void)n;
+}
+
+static inline void scroll_snap_core_decided(struct scroll_snap_core *core, uint8_t direction) {
+    (void)core;
+    (void)direction;
+}
+#endif
+
+// Forget the collected samples and lock state. Ring slots are not cleared: they are only read
+// back after being overwritten, so a reset costs the same as any other event.
+static inline void scroll_snap_core_reset(struct scroll_snap_core *core) {
+    core->sample_count = 0;
+    core->sample_sum.dx = 0;
+    core->sample_sum.dy = 0;
+    core->remainder.dx = 0;
+    core->remainder.dy = 0;
+    core->diag_owed.dx = 0;
+    core->diag_owed.dy = 0;
+    core->output_pending.dx = 0;
+    core->output_pending.dy = 0;
+    core->negative_x = false;
+    core->negative_y = false;
+    core->frame_emitted = false;
+    core->warmup_held = false;
+    core->head = 0;
+    core->window_open = false;
+    core->guess_direction = DIRECTION_NONE;
+    core->lock_events_remaining = 0;
+    core->lock_direction = DIRECTION_NONE;
+    core->lock_expires_at = 0;
+}
+
+// Account the time a lock was held before it is released or reset. Instances without a time
+// source see a constant now, so their hold time is not counted rather than counted as zero.
+static inline void scroll_snap_core_lock_end(struct scroll_snap_core *core,
+                                             const struct scroll_snap_params *params,
+                                             scroll_snap_time_t now) {
+    if (SCROLL_SNAP_TUNED(params, uses_time) && core->lock_direction != DIRECTION_NONE) {
+        scroll_snap_core_count(core, SCROLL_SNAP_STAT_LOCK_HELD_TICKS,
+                               scroll_snap_elapsed(now, core->lock_started_at));
+    }
+}
+
+static inline void scroll_snap_core_release_lock(struct scroll_snap_core *core,
+                                                 const struct scroll_snap_params *params,
+                                                 scroll_snap_time_t now) {
+    scroll_snap_core_lock_end(core, params, now);
+    core->lock_direction = DIRECTION_NONE;
+    core->lock_expires_at = 0;
+    core->lock_events_remaining = 0;
+}
+
+// Delay until a timer should first look at the state: the nearest configured deadline
+static inline uint32_t scroll_snap_expiry_delay(uint32_t idle_reset_timeout, uint32_t lock_duration) {
+    if (idle_reset_timeout == 0) {
+        return lock_duration;
+    }
+    if (lock_duration == 0) {
+        return idle_reset_timeout;
+    }
+    return MIN(idle_reset_timeout, lock_duration);
+}
+
+static inline uint32_t scroll_snap_core_expiry_delay(const struct scroll_snap_params *params) {
+    return scroll_snap_expiry_delay(SCROLL_SNAP_TUNED(params, idle_reset_timeout),
+                                    SCROLL_SNAP_TUNED(params, lock_duration));
+}
+
+// Apply the idle reset and time-based lock expiry due at now. Called before each event, or from
+// a timer. Returns the ticks until the next deadline that is still pending, or UINT32_MAX.
+static inline uint32_t scroll_snap_core_expire(struct scroll_snap_core *core,
+                                               const struct scroll_snap_params *params,
+                                               scroll_snap_time_t now) {
+    uint32_t idle_reset_timeout = SCROLL_SNAP_TUNED(params, idle_reset_timeout);
+    uint32_t next = UINT32_MAX;
+
+    if (idle_reset_timeout > 0) {
+        uint32_t idle = scroll_snap_elapsed(now, core->last_event_ts);
+        if (idle >= idle_reset_timeout) {
+            scroll_snap_core_lock_end(core, params, now);
+            scroll_snap_core_reset(core);
+            return UINT32_MAX;
+        }
+        next = idle_reset_timeout - idle;
+    }
+
+    if (core->lock_direction != DIRECTION_NONE && SCROLL_SNAP_TUNED(params, lock_duration) > 0) {
+        if (scroll_snap_time_reached(now, core->lock_expires_at)) {
+            scroll_snap_core_release_lock(core, params, now);
+        } else {
+            next = MIN(next, scroll_snap_elapsed(core->lock_expires_at, now));
+        }
+    }
+
+    return next;
+}
+
+// Clamp an accumulated sum into the configured magnitude width
+static inline scroll_snap_mag_t scroll_snap_magnitude(int32_t sum) {
+    return (scroll_snap_mag_t)MIN((uint32_t)MAX(sum, 0), SCROLL_SNAP_MAG_MAX);
+}
+
+// Compare a * a_mul < b * b_mul without overflow for any magnitude and threshold term
+static inline bool scroll_snap_ratio_lt(scroll_snap_mag_t a, uint32_t a_mul, scroll_snap_mag_t b,
+                                        uint32_t b_mul) {
+    return (scroll_snap_prod_t)a * a_mul < (scroll_snap_prod_t)b * b_mul;
+}
+
+// Advance a ring index without an integer division: a mask for power-of-two rings,
+// a compare-and-reset otherwise
+static inline uint16_t scroll_snap_ring_next(const struct scroll_snap_params *params, uint16_t idx) {
+#if defined(CONFIG_ZMK_SCROLL_SNAP_RING_POW2)
+    return (idx + 1) & (SCROLL_SNAP_TUNED(params, require_n_samples) - 1);
+#else
+    idx++;
+    return idx >= SCROLL_SNAP_TUNED(params, require_n_samples) ? 0 : idx;
+#endif
+}
+
+// Store an incoming value in a ring slot and return the magnitude added to the sums
+static inline uint32_t scroll_snap_slot_store(scroll_snap_slot_t *slot, bool is_x_axis,
+                                              int32_t value) {
+#if defined(CONFIG_ZMK_SCROLL_SNAP_SAMPLE_STORAGE_PACKED)
+    uint32_t magnitude = MIN((uint32_t)abs(value), SCROLL_SNAP_SLOT_MAGNITUDE_MAX);
+    *slot = magnitude | (is_x_axis ? 0 : SCROLL_SNAP_SLOT_AXIS_Y);
+    return magnitude;
+#else
+    // Stored clamped, so eviction takes out exactly what was added
+    int32_t clamped =
+        CLAMP(value, -SCROLL_SNAP_SAMPLE_MAGNITUDE_MAX, SCROLL_SNAP_SAMPLE_MAGNITUDE_MAX);
+    slot->dx = is_x_axis ? clamped : 0;
+    slot->dy = is_x_axis ? 0 : clamped;
+    return abs(clamped);
+#endif
+}
+
+// Remove the contribution of an evicted ring slot from the sums
+static inline void scroll_snap_slot_evict(struct scroll_snap_core *core,
+                                          const scroll_snap_slot_t *slot) {
+#if defined(CONFIG_ZMK_SCROLL_SNAP_SAMPLE_STORAGE_PACKED)
+    int32_t magnitude = *slot & SCROLL_SNAP_SLOT_MAGNITUDE_MAX;
+    if (*slot & SCROLL_SNAP_SLOT_AXIS_Y) {
+        core->sample_sum.dy -= magnitude;
+    } else {
+        core->sample_sum.dx -= magnitude;
+    }
+#else
+    core->sample_sum.dx -= abs(slot->dx);
+    core->sample_sum.dy -= abs(slot->dy);
+#endif
+}
+
+// Drop samples older than sample-window-ms from the tail of the ring
+static inline void scroll_snap_ring_expire(struct scroll_snap_core *core,
+                                           const struct scroll_snap_params *params,
+                                           scroll_snap_time_t now) {
+    uint16_t ring_size = SCROLL_SNAP_TUNED(params, require_n_samples);
+    uint16_t tail = core->head >= core->sample_count ? core->head - core->sample_count
+                                                     : core->head + ring_size - core->sample_count;
+
+    while (core->sample_count > 0 &&
+           scroll_snap_elapsed(now, params->sample_ts[tail]) >= params->sample_window) {
+        scroll_snap_slot_evict(core, &params->samples[tail]);
+        tail = scroll_snap_ring_next(params, tail);
+        core->sample_count--;
+    }
+
+    // Every sample aged out: the next one starts collection over, as after an idle reset
+    if (core->sample_count == 0) {
+        core->window_open = false;
+    }
+}
+
+// Motion that was not emitted on the snapped axis: carried forward when tracking remainders,
+// bounded by what the sample window has seen on that axis so a later direction change cannot
+// release a burst of stale motion
+static inline int32_t scroll_snap_carry(const struct scroll_snap_params *params, int32_t remainder,
+                                        uint32_t window_sum) {
+    if (!params->track_remainders) {
+        return 0;
+    }
+    return CLAMP(remainder, -(int32_t)window_sum, (int32_t)window_sum);
+}
+
+// Per-event EMA decay of a sum, rounded up so a sum below 2^shift still decays to zero instead
+// of sticking at a small residue
+static inline int32_t scroll_snap_ema_decay(int32_t sum, uint8_t shift) {
+    return (int32_t)(((uint32_t)sum + (1U << shift) - 1) >> shift);
+}
+
+// Decay both axes of the EMA sums and add the incoming magnitude in fixed point
+static inline void scroll_snap_ema_update(struct scroll_snap_core *core,
+                                          const struct scroll_snap_params *params, bool is_x_axis,
+                                          int32_t value) {
+    core->sample_sum.dx -= scroll_snap_ema_decay(core->sample_sum.dx, params->ema_shift);
+    core->sample_sum.dy -= scroll_snap_ema_decay(core->sample_sum.dy, params->ema_shift);
+
+    int32_t magnitude = MIN((uint32_t)abs(value), params->ema_magnitude_max)
+                        << SCROLL_SNAP_EMA_FRAC_BITS;
+    if (is_x_axis) {
+        core->sample_sum.dx += magnitude;
+    } else {
+        core->sample_sum.dy += magnitude;
+    }
+}
+
+// Decay both axes of the EMA sums in proportion to the time elapsed since the last event
+static inline void scroll_snap_ema_decay_elapsed(struct scroll_snap_core *core,
+                                                 const struct scroll_snap_params *params,
+                                                 uint32_t elapsed) {
+    if (elapsed >= params->sample_window) {
+        // Everything decayed: the next sample starts collection over, as after an idle reset
+        core->sample_sum.dx = 0;
+        core->sample_sum.dy = 0;
+        core->sample_count = 0;
+        core->window_open = false;
+        return;
+    }
+
+    // sum * elapsed / window, with the division replaced by a precomputed 0.32 reciprocal
+    uint32_t factor = (uint32_t)(((uint64_t)elapsed * params->sample_window_recip) >> 16);
+    core->sample_sum.dx -= MIN((int32_t)(((uint64_t)core->sample_sum.dx * factor) >> 16), core->sample_sum.dx);
+    core->sample_sum.dy -= MIN((int32_t)(((uint64_t)core->sample_sum.dy * factor) >> 16), core->sample_sum.dy);
+}
+
+// Speed of the collected motion as a fraction of velocity-fast, in 1/256 steps. The speed is the
+// mean magnitude per event: the sum over the samples collected so far, or over the EMA length
+// once the EMA has warmed up.
+static inline uint32_t scroll_snap_velocity_q8(const struct scroll_snap_core *core,
+                                               const struct scroll_snap_params *params,
+                                               scroll_snap_mag_t abs_x, scroll_snap_mag_t abs_y) {
+    uint32_t total = (uint32_t)MIN((uint64_t)abs_x + abs_y, (uint64_t)UINT32_MAX);
+    uint32_t mean;
+
+    if (params->estimator == SCROLL_SNAP_ESTIMATOR_EMA &&
+        core->sample_count >= SCROLL_SNAP_TUNED(params, require_n_samples)) {
+        mean = total >> params->ema_shift;
+    } else {
+        mean = (uint32_t)(((uint64_t)total * scroll_snap_count_recip[core->sample_count]) >> 15);
+    }
+
+    if (mean >= params->velocity_fast) {
+        return 256;
+    }
+    return (mean * params->velocity_fast_recip) >> 16;
+}
+
+// Scale a magnitude by a factor of at most 1, in 1/256 steps
+static inline scroll_snap_mag_t scroll_snap_scale_q8(scroll_snap_mag_t mag, uint32_t factor_q8) {
+    return (scroll_snap_mag_t)(((scroll_snap_prod_t)mag * factor_q8) >> 8);
+}
+
+// Whether a held axis lock cannot need a refresh on this event: a time lock is only refreshed in
+// the second half of its duration, an event lock only once half of its events are used up.
+// Diagonal locks always take the full path, as they need the projection of fresh motion.
+static inline bool scroll_snap_lock_fast_path(const struct scroll_snap_core *core,
+                                              const struct scroll_snap_params *params,
+                                              scroll_snap_time_t now) {
+    if (!params->lock_fast_path ||
+        (core->lock_direction != DIRECTION_X && core->lock_direction != DIRECTION_Y)) {
+        return false;
+    }
+    uint32_t lock_duration = SCROLL_SNAP_TUNED(params, lock_duration);
+    uint16_t lock_events = SCROLL_SNAP_TUNED(params, lock_for_next_n_events);
+
+    if (lock_duration > 0) {
+        return !scroll_snap_time_reached(now, core->lock_expires_at - lock_duration / 2);
+    }
+    if (lock_events > 0) {
+        return core->lock_events_remaining > (lock_events + 1) / 2;
+    }
+    return false;
+}
+
+// Detect the snap direction of the collected motion from the thresholds. The axis tests use the
+// off-axis magnitudes as scaled by velocity adaptation.
+static inline uint8_t scroll_snap_detect(const struct scroll_snap_core *core,
+                                         const struct scroll_snap_params *params,
+                                         scroll_snap_mag_t abs_x, scroll_snap_mag_t abs_y,
+                                         scroll_snap_mag_t off_x, scroll_snap_mag_t off_y) {
+    uint32_t xy_num = SCROLL_SNAP_TUNED(params, xy_thresh_num);
+    uint32_t xy_den = SCROLL_SNAP_TUNED(params, xy_thresh_den);
+
+    if (scroll_snap_ratio_lt(off_x, SCROLL_SNAP_TUNED(params, y_thresh_num), abs_y,
+                             SCROLL_SNAP_TUNED(params, y_thresh_den))) {
+        return DIRECTION_Y;
+    }
+    if (scroll_snap_ratio_lt(off_y, SCROLL_SNAP_TUNED(params, x_thresh_den), abs_x,
+                             SCROLL_SNAP_TUNED(params, x_thresh_num))) {
+        return DIRECTION_X;
+    }
+    if (scroll_snap_ratio_lt(abs_x, xy_num, abs_y, xy_den) &&
+        scroll_snap_ratio_lt(abs_y, xy_num, abs_x, xy_den)) {
+        return (core->negative_x == core->negative_y) ? DIRECTION_DIAG_PLUS : DIRECTION_DIAG_MINUS;
+    }
+    return DIRECTION_NONE;
+}
+
+// LUT entry of the log ratio b/a of two nonzero magnitudes
+static inline uint8_t scroll_snap_lut_lookup(const struct scroll_snap_params *params,
+                                             scroll_snap_mag_t a, scroll_snap_mag_t b) {
+    int32_t ratio = CLAMP(SCROLL_SNAP_LOG2_Q4(b) - SCROLL_SNAP_LOG2_Q4(a), -SCROLL_SNAP_LUT_RANGE,
+                          SCROLL_SNAP_LUT_RANGE);
+
+    return params->direction_lut[ratio + SCROLL_SNAP_LUT_RANGE];
+}
+
+// Detect the snap direction with the direction LUT: one lookup at the quantized log ratio of the
+// magnitudes, or one per threshold test under velocity adaptation, whose axis tests use the
+// scaled off-axis magnitudes. Ratios close to a threshold and zero magnitudes are left to
+// scroll_snap_detect(), so the result always matches the threshold tests.
+static inline uint8_t scroll_snap_classify(const struct scroll_snap_core *core,
+                                           const struct scroll_snap_params *params,
+                                           scroll_snap_mag_t abs_x, scroll_snap_mag_t abs_y,
+                                           scroll_snap_mag_t off_x, scroll_snap_mag_t off_y) {
+    uint8_t direction;
+
+    if (off_x == 0 || off_y == 0) {
+        return scroll_snap_detect(core, params, abs_x, abs_y, off_x, off_y);
+    }
+
+    if (off_x == abs_x && off_y == abs_y) {
+        direction = scroll_snap_lut_lookup(params, abs_x, abs_y);
+    } else {
+        direction = scroll_snap_lut_lookup(params, off_x, abs_y);
+        if (direction != DIRECTION_Y && direction != SCROLL_SNAP_LUT_EXACT) {
+            direction = scroll_snap_lut_lookup(params, abs_x, off_y);
+            if (direction != DIRECTION_X && direction != SCROLL_SNAP_LUT_EXACT) {
+                direction = scroll_snap_lut_lookup(params, abs_x, abs_y);
+            }
+        }
+    }
+
+    if (direction == SCROLL_SNAP_LUT_EXACT) {
+        return scroll_snap_detect(core, params, abs_x, abs_y, off_x, off_y);
+    }
+    if (direction == DIRECTION_DIAG_PLUS && core->negative_x != core->negative_y) {
+        return DIRECTION_DIAG_MINUS;
+    }
+    return direction;
+}
+
+// Guess the axis of the motion collected so far: the magnitude on it has to exceed num/den times
+// the other one. A previous guess is kept until the other axis leads by that margin. Returns
+// whether there is a guess.
+static inline bool scroll_snap_speculate(struct scroll_snap_core *core,
+                                         const struct scroll_snap_params *params,
+                                         scroll_snap_mag_t abs_x, scroll_snap_mag_t abs_y) {
+    uint8_t guess = core->guess_direction;
+
+    if (scroll_snap_ratio_lt(abs_x, params->speculative_num, abs_y, params->speculative_den)) {
+        guess = DIRECTION_Y;
+    } else if (scroll_snap_ratio_lt(abs_y, params->speculative_num, abs_x, params->speculative_den)) {
+        guess = DIRECTION_X;
+    }
+
+    if (core->guess_direction != DIRECTION_NONE && guess != core->guess_direction) {
+        scroll_snap_core_count(core, SCROLL_SNAP_STAT_SPECULATION_REVISED, 1);
+    }
+    core->guess_direction = guess;
+    return guess != DIRECTION_NONE;
+}
+
+// Whether the held axis is kept: it is left only once the off-axis share exceeds the
+// hysteresis threshold, which is looser than the one needed to enter it
+static inline bool scroll_snap_hysteresis_holds(const struct scroll_snap_core *core,
+                                                const struct scroll_snap_params *params,
+                                                scroll_snap_mag_t abs_x, scroll_snap_mag_t abs_y) {
+    switch (core->lock_direction) {
+        case DIRECTION_X:
+            return !scroll_snap_ratio_lt(abs_x, params->hysteresis_num, abs_y, params->hysteresis_den);
+        case DIRECTION_Y:
+            return !scroll_snap_ratio_lt(abs_y, params->hysteresis_num, abs_x, params->hysteresis_den);
+        default:
+            return false;
+    }
+}
+
+// Add snapped motion to the pending output of its axis and return the whole output steps of it.
+// The rest keeps its sign and is carried to the next event on that axis. The steps are counted
+// with a shift or a multiply by the reciprocal, so no division is done even when the step is
+// not a compile-time constant.
+static inline int32_t scroll_snap_quantize(struct scroll_snap_core *core,
+                                           const struct scroll_snap_params *params, bool is_x_axis,
+                                           int32_t value) {
+    int32_t *pending = is_x_axis ? &core->output_pending.dx : &core->output_pending.dy;
+
+    *pending += value;
+
+    uint32_t magnitude = *pending < 0 ? 0U - (uint32_t)*pending : (uint32_t)*pending;
+    uint32_t steps;
+
+    if (params->output_step_shift > 0) {
+        steps = magnitude >> params->output_step_shift;
+    } else {
+        // The rounded-up reciprocal overshoots by less than one step
+        steps = (uint32_t)(((uint64_t)magnitude * params->output_step_recip) >> 32);
+        if (steps * params->output_step > magnitude) {
+            steps--;
+        }
+    }
+
+    int32_t out = (int32_t)(steps * params->output_step);
+
+    if (*pending < 0) {
+        out = -out;
+    }
+    *pending -= out;
+    return out;
+}
+
+// Decide whether a processed event is passed on, after quantizing it to the output step.
+// Zero-valued events are dropped when suppress-zero-events or an output step is set, unless they
+// carry the sync for a value already sent in this frame. The motion held back while collecting
+// samples goes out as a single sync'd event, so the zero events left in its report are dropped.
+static inline bool scroll_snap_forward(struct scroll_snap_core *core,
+                                       const struct scroll_snap_params *params,
+                                       struct scroll_snap_event *ev) {
+    if (params->output_step > 1) {
+        ev->value = scroll_snap_quantize(core, params, ev->is_x_axis, ev->value);
+    } else if (!params->suppress_zero_events) {
+        return true;
+    }
+
+    if (ev->value != 0) {
+        if (core->warmup_held) {
+            core->warmup_held = false;
+            ev->sync = true;
+        }
+        core->frame_emitted = !ev->sync;
+        return true;
+    }
+
+    if (ev->sync && core->frame_emitted) {
+        core->frame_emitted = false;
+        return true;
+    }
+
+    scroll_snap_core_count(core, SCROLL_SNAP_STAT_ZERO_SUPPRESSED, 1);
+    return false;
+}
+
+// Add one value to the sample window, the pending motion and the sign tracking, and return the
+// magnitudes of the window sums
+static ALWAYS_INLINE void scroll_snap_core_accumulate(struct scroll_snap_core *core,
+                                                      const struct scroll_snap_params *params,
+                                                      bool is_x_axis, int32_t value,
+                                                      scroll_snap_time_t now,
+                                                      scroll_snap_mag_t *abs_x,
+                                                      scroll_snap_mag_t *abs_y) {
+    uint32_t elapsed = scroll_snap_elapsed(now, core->last_event_ts);
+
+    core->last_event_ts = now;
+
+    if (params->estimator == SCROLL_SNAP_ESTIMATOR_EMA) {
+        if (params->sample_window > 0) {
+            scroll_snap_ema_decay_elapsed(core, params, elapsed);
+        }
+        scroll_snap_ema_update(core, params, is_x_axis, value);
+        *abs_x = scroll_snap_magnitude(core->sample_sum.dx >> SCROLL_SNAP_EMA_FRAC_BITS);
+        *abs_y = scroll_snap_magnitude(core->sample_sum.dy >> SCROLL_SNAP_EMA_FRAC_BITS);
+    } else {
+        // Accumulate samples using ring buffer
+        if (params->sample_ts != NULL && params->sample_window > 0) {
+            scroll_snap_ring_expire(core, params, now);
+        }
+
+        // When buffer is full, delete the oldest sample
+        if (core->sample_count >= SCROLL_SNAP_TUNED(params, require_n_samples)) {
+            scroll_snap_slot_evict(core, &params->samples[core->head]);
+        }
+
+        uint32_t magnitude = scroll_snap_slot_store(&params->samples[core->head], is_x_axis, value);
+        if (params->sample_ts != NULL) {
+            params->sample_ts[core->head] = now;
+        }
+        if (is_x_axis) {
+            core->sample_sum.dx += magnitude;
+        } else {
+            core->sample_sum.dy += magnitude;
+        }
+        core->head = scroll_snap_ring_next(params, core->head);
+
+        *abs_x = scroll_snap_magnitude(core->sample_sum.dx);
+        *abs_y = scroll_snap_magnitude(core->sample_sum.dy);
+    }
+
+    // Opened after aging out old samples, which may have emptied the window
+    if (!core->window_open) {
+        core->window_open = true;
+        core->window_start = now;
+    }
+
+    if (is_x_axis) {
+        core->remainder.dx += value;
+        if (value != 0) {
+            core->negative_x = value < 0;
+        }
+    } else {
+        core->remainder.dy += value;
+        if (value != 0) {
+            core->negative_y = value < 0;
+        }
+    }
+    if (core->sample_count < SCROLL_SNAP_TUNED(params, require_n_samples)) {
+        core->sample_count++;
+    }
+}
+
+// Snap decision shared by the event and frame entry points
+struct scroll_snap_decision {
+    uint8_t direction;
+    // Motion to emit per axis. The emitted motion is consumed by the caller.
+    int32_t x;
+    int32_t y;
+};
+
+// Decide the snap direction for the collected motion, split the pending motion into what is
+// emitted on each axis and what is carried, and update the lock. Returns false while still
+// collecting samples.
+static ALWAYS_INLINE bool scroll_snap_core_decide(struct scroll_snap_core *core,
+                                                  const struct scroll_snap_params *params,
+                                                  scroll_snap_time_t now, scroll_snap_mag_t abs_x,
+                                                  scroll_snap_mag_t abs_y,
+                                                  struct scroll_snap_decision *out,
+                                                  enum scroll_snap_path *path) {
+    // A held axis lock that cannot need a refresh on this event skips the readiness check,
+    // direction detection and lock handling
+    bool fast_path = scroll_snap_lock_fast_path(core, params, now);
+    uint32_t lock_duration = SCROLL_SNAP_TUNED(params, lock_duration);
+    uint16_t lock_events = SCROLL_SNAP_TUNED(params, lock_for_next_n_events);
+    uint32_t immediate = SCROLL_SNAP_TUNED(params, immediate_snap_threshold);
+
+    // Velocity adaptation: the faster the motion, the fewer samples are needed and the more
+    // off-axis motion still snaps to an axis
+    uint32_t window_samples = SCROLL_SNAP_TUNED(params, require_n_samples);
+    uint32_t required_samples = window_samples;
+    scroll_snap_mag_t off_x = abs_x, off_y = abs_y;
+    if (!fast_path && params->velocity_fast > 0) {
+        uint32_t velocity = scroll_snap_velocity_q8(core, params, abs_x, abs_y);
+        uint32_t off_axis_q8 = 256 - (((256 - params->velocity_off_axis_q8) * velocity) >> 8);
+
+        required_samples -=
+            ((window_samples - SCROLL_SNAP_TUNED(params, velocity_fast_samples)) * velocity) >> 8;
+        off_x = scroll_snap_scale_q8(abs_x, off_axis_q8);
+        off_y = scroll_snap_scale_q8(abs_y, off_axis_q8);
+    }
+
+    // Whether the dominant axis is emitted before the window is complete
+    bool speculative = false;
+
+    if (!fast_path) {
+        // Check if we have enough samples, or have been collecting for the whole time window
+        bool window_elapsed = params->sample_window > 0 &&
+                              scroll_snap_elapsed(now, core->window_start) >= params->sample_window;
+        if (!(core->sample_count >= required_samples || window_elapsed || abs_x > immediate ||
+              abs_y > immediate)) {
+            // Speculation never overrides a held lock
+            speculative = params->speculative_num > 0 && core->lock_direction == DIRECTION_NONE &&
+                          scroll_snap_speculate(core, params, abs_x, abs_y);
+            if (!speculative) {
+                scroll_snap_core_count(core, SCROLL_SNAP_STAT_WARMUP_SWALLOWED, 1);
+                *path = SCROLL_SNAP_PATH_ACCUMULATE;
+                return false;
+            }
+            scroll_snap_core_count(core, SCROLL_SNAP_STAT_SPECULATIVE_SNAPS, 1);
+        } else if (core->sample_count < required_samples && !window_elapsed) {
+            scroll_snap_core_count(core, SCROLL_SNAP_STAT_IMMEDIATE_SNAPS, 1);
+        }
+    }
+
+    bool is_lock_active = fast_path;
+    uint8_t detected_direction = speculative ? core->guess_direction : core->lock_direction;
+
+    if (!fast_path && !speculative) {
+        // A hysteresis hold costs one compare; the thresholds are only evaluated once it is left
+        if (params->hysteresis_num > 0) {
+            is_lock_active = scroll_snap_hysteresis_holds(core, params, abs_x, abs_y);
+        }
+        if (!is_lock_active) {
+            detected_direction =
+                params->direction_lut != NULL
+                    ? scroll_snap_classify(core, params, abs_x, abs_y, off_x, off_y)
+                    : scroll_snap_detect(core, params, abs_x, abs_y, off_x, off_y);
+        }
+
+        // Check if lock is active. A time lock that ran out is released here, so it ends on
+        // time even when the caller only applies scroll_snap_core_expire() now and then.
+        if (lock_duration > 0 && core->lock_direction != DIRECTION_NONE) {
+            if (scroll_snap_time_reached(now, core->lock_expires_at)) {
+                scroll_snap_core_release_lock(core, params, now);
+            } else {
+                is_lock_active = true;
+            }
+        }
+        is_lock_active |= (core->lock_events_remaining > 0);
+    }
+
+    // Snap to the decided direction
+    uint8_t decided_direction = is_lock_active ? core->lock_direction : detected_direction;
+    if (params->speculative_num > 0 && !speculative && core->guess_direction != DIRECTION_NONE) {
+        // The first decision on the full window confirms or revises the guess
+        if (decided_direction != core->guess_direction) {
+            scroll_snap_core_count(core, SCROLL_SNAP_STAT_SPECULATION_REVISED, 1);
+        }
+        core->guess_direction = DIRECTION_NONE;
+    }
+    scroll_snap_core_decided(core, decided_direction);
+    if (is_lock_active) {
+        scroll_snap_core_count(core, SCROLL_SNAP_STAT_LOCKED_EVENTS, 1);
+    }
+    switch (decided_direction) {
+        case DIRECTION_X:
+            scroll_snap_core_count(core, SCROLL_SNAP_STAT_SNAP_X, 1);
+            out->x = core->remainder.dx + core->diag_owed.dx;
+            out->y = 0;
+            core->remainder.dy = scroll_snap_carry(params, core->remainder.dy, abs_y);
+            core->diag_owed.dy = 0;
+            break;
+        case DIRECTION_Y:
+            scroll_snap_core_count(core, SCROLL_SNAP_STAT_SNAP_Y, 1);
+            out->y = core->remainder.dy + core->diag_owed.dy;
+            out->x = 0;
+            core->remainder.dx = scroll_snap_carry(params, core->remainder.dx, abs_x);
+            core->diag_owed.dx = 0;
+            break;
+        case DIRECTION_DIAG_PLUS:
+        case DIRECTION_DIAG_MINUS: {
+            scroll_snap_core_count(core, SCROLL_SNAP_STAT_SNAP_DIAG, 1);
+            // Project the pending motion onto y = +x or y = -x: p = (dx +- dy) / 2 on both axes.
+            // Only the current event's axis can be emitted now, the other one is owed.
+            int32_t sign = decided_direction == DIRECTION_DIAG_PLUS ? 1 : -1;
+            int32_t along = core->remainder.dx + sign * core->remainder.dy;
+            int32_t projected = along / 2;
+            // The odd unit lost by the halving is carried as pending x motion
+            core->remainder.dx = params->track_remainders ? along - 2 * projected : 0;
+            core->remainder.dy = 0;
+            core->diag_owed.dx += projected;
+            core->diag_owed.dy += sign * projected;
+            out->x = core->diag_owed.dx;
+            out->y = core->diag_owed.dy;
+            break;
+        }
+        default:
+            scroll_snap_core_count(core, SCROLL_SNAP_STAT_SNAP_NONE, 1);
+            out->x = 0;
+            out->y = 0;
+            // Without remainder tracking, only the motion of the current event is dropped by
+            // the caller, as it always was
+            if (params->track_remainders) {
+                core->remainder.dx = scroll_snap_carry(params, core->remainder.dx, abs_x);
+                core->remainder.dy = scroll_snap_carry(params, core->remainder.dy, abs_y);
+            }
+            break;
+    }
+
+    // Lock handling: start/refresh/decrement
+    if (fast_path) {
+        // Only an event lock counts down here; the fast path always leaves it at least one event
+        if (lock_duration == 0) {
+            core->lock_events_remaining--;
+        }
+    } else if (speculative) {
+        // Locks are only started from the full window
+    } else if (params->hysteresis_num > 0) {
+        // Hold a newly detected axis; diagonals and no-snap decisions are not held
+        if (!is_lock_active && detected_direction != core->lock_direction) {
+            scroll_snap_core_lock_end(core, params, now);
+            core->lock_direction = DIRECTION_NONE;
+            if (detected_direction == DIRECTION_X || detected_direction == DIRECTION_Y) {
+                scroll_snap_core_count(core, SCROLL_SNAP_STAT_LOCKS_STARTED, 1);
+                core->lock_started_at = now;
+                core->lock_direction = detected_direction;
+            }
+        }
+    } else if (lock_duration > 0 || lock_events > 0) {
+        if (is_lock_active) {
+            // Refresh when detected direction matches current lock
+            if (detected_direction != DIRECTION_NONE && detected_direction == core->lock_direction) {
+                if (lock_duration > 0) {
+                    core->lock_expires_at = now + lock_duration;
+                }
+                if (lock_events > 0) {
+                    core->lock_events_remaining = lock_events;
+                }
+            } else {
+                // No refresh: decrement event-based lock
+                if (lock_duration == 0 && lock_events > 0) {
+                    if (core->lock_events_remaining > 0) {
+                        core->lock_events_remaining--;
+                        if (core->lock_events_remaining == 0) {
+                            scroll_snap_core_lock_end(core, params, now);
+                            core->lock_direction = DIRECTION_NONE;
+                        }
+                    }
+                }
+            }
+        } else if (decided_direction != DIRECTION_NONE) {
+            // Start a new lock
+            scroll_snap_core_count(core, SCROLL_SNAP_STAT_LOCKS_STARTED, 1);
+            core->lock_started_at = now;
+            if (lock_duration > 0) {
+                core->lock_direction = decided_direction;
+                core->lock_expires_at = now + lock_duration;
+                core->lock_events_remaining = 0;
+            }
+            if (lock_events > 0) {
+                core->lock_direction = decided_direction;
+                core->lock_events_remaining = lock_events;
+            }
+        } else {
+            // No locking configured or no decision
+            if (lock_duration == 0 && lock_events == 0) {
+                core->lock_direction = DIRECTION_NONE;
+                core->lock_events_remaining = 0;
+                core->lock_expires_at = 0;
+            }
+        }
+    }
+
+    out->direction = decided_direction;
+    *path = fast_path        ? SCROLL_SNAP_PATH_FAST
+            : is_lock_active ? SCROLL_SNAP_PATH_LOCKED
+                             : SCROLL_SNAP_PATH_DECIDE;
+    return true;
+}
+
+// Run one event through the decision core and rewrite it to its snapped form. Returns whether
+// the event is passed on. Idle reset and lock expiry are not applied here: the caller runs
+// scroll_snap_core_expire() before the event or from a timer.
+//
+// Always inlined so per-instance handlers get their parameters as compile-time constants.
+static ALWAYS_INLINE bool scroll_snap_core_process(struct scroll_snap_core *core,
+                                                   const struct scroll_snap_params *params,
+                                                   struct scroll_snap_event *ev,
+                                                   scroll_snap_time_t now,
+                                                   enum scroll_snap_path *path) {
+    bool is_x_axis = ev->is_x_axis;
+    scroll_snap_mag_t abs_x, abs_y;
+
+    scroll_snap_core_accumulate(core, params, is_x_axis, ev->value, now, &abs_x, &abs_y);
+
+    // Hold the axes of a report back until its last (sync) event, then decide once for the frame
+    if (params->coalesce_frames && !ev->sync) {
+        // The sync event can only carry one axis, so diagonal motion owed to this axis rides here
+        int32_t *owed = is_x_axis ? &core->diag_owed.dx : &core->diag_owed.dy;
+        if (*owed != 0) {
+            ev->value = *owed;
+            *owed = 0;
+            *path = SCROLL_SNAP_PATH_DECIDE;
+            return scroll_snap_forward(core, params, ev);
+        }
+        *path = SCROLL_SNAP_PATH_ACCUMULATE;
+        return false;
+    }
+
+    struct scroll_snap_decision d;
+    if (!scroll_snap_core_decide(core, params, now, abs_x, abs_y, &d, path)) {
+        core->warmup_held = true;
+        ev->value = 0;
+        ev->sync = false;
+        return false;
+    }
+
+    // Modify the current event to be the snapped scroll version and consume what was emitted
+    bool emit_x = is_x_axis;
+    if (params->coalesce_frames && (d.direction == DIRECTION_X || d.direction == DIRECTION_Y)) {
+        // The sync event carries the whole frame on the snapped axis
+        emit_x = d.direction == DIRECTION_X;
+        ev->is_x_axis = emit_x;
+    }
+
+    if (d.direction == DIRECTION_NONE) {
+        ev->value = 0;
+        if (!params->track_remainders) {
+            *(is_x_axis ? &core->remainder.dx : &core->remainder.dy) = 0;
+        }
+    } else if (emit_x) {
+        ev->value = d.x;
+        core->diag_owed.dx = 0;
+        if (d.direction == DIRECTION_X) {
+            core->remainder.dx = 0;
+        }
+    } else {
+        ev->value = d.y;
+        core->diag_owed.dy = 0;
+        if (d.direction == DIRECTION_Y) {
+            core->remainder.dy = 0;
+        }
+    }
+
+    return scroll_snap_forward(core, params, ev);
+}
+
+// Run one frame of motion through the decision core: both deltas are added to the window once,
+// one decision is made and the snapped motion of both axes is returned in place. Returns whether
+// the frame is passed on. Expiry is left to the caller as for scroll_snap_core_process().
+static ALWAYS_INLINE bool scroll_snap_core_process_frame(struct scroll_snap_core *core,
+                                                         const struct scroll_snap_params *params,
+                                                         int32_t *dx, int32_t *dy,
+                                                         scroll_snap_time_t now,
+                                                         enum scroll_snap_path *path) {
+    scroll_snap_mag_t abs_x, abs_y;
+
+    // An idle axis is not a sample, as a device would not report it either
+    if (*dx != 0 || *dy == 0) {
+        scroll_snap_core_accumulate(core, params, true, *dx, now, &abs_x, &abs_y);
+    }
+    if (*dy != 0) {
+        scroll_snap_core_accumulate(core, params, false, *dy, now, &abs_x, &abs_y);
+    }
+
+    struct scroll_snap_decision d;
+    if (!scroll_snap_core_decide(core, params, now, abs_x, abs_y, &d, path)) {
+        *dx = 0;
+        *dy = 0;
+        return false;
+    }
+
+    // Both axes are emitted together, so nothing is owed to a later event
+    *dx = d.x;
+    *dy = d.y;
+    if (params->output_step > 1) {
+        *dx = scroll_snap_quantize(core, params, true, *dx);
+        *dy = scroll_snap_quantize(core, params, false, *dy);
+    }
+    switch (d.direction) {
+        case DIRECTION_X:
+            core->remainder.dx = 0;
+            break;
+        case DIRECTION_Y:
+            core->remainder.dy = 0;
+            break;
+        case DIRECTION_NONE:
+            // The frame is the current event on both axes
+            if (!params->track_remainders) {
+                core->remainder.dx = 0;
+                core->remainder.dy = 0;
+            }
+            break;
+        default:
+            break;
+    }
+    core->diag_owed.dx = 0;
+    core->diag_owed.dy = 0;
+
+    if ((params->suppress_zero_events || params->output_step > 1) && *dx == 0 && *dy == 0) {
+        scroll_snap_core_count(core, SCROLL_SNAP_STAT_ZERO_SUPPRESSED, 1);
+        return false;
+    }
+    return true;
+}
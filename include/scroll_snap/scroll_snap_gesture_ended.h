@@ -0,0 +1,24 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zephyr/device.h>
+#include <zmk/event_manager.h>
+
+/**
+ * Raised from the system work queue once an instance saw no motion for its expiry delay, the
+ * shorter of idle-reset-timeout-ms and lock-duration-ms, i.e. once its idle reset or lock expiry
+ * is due. The state itself is only reset or released when the next event arrives, so it may still
+ * show the ended gesture while this event is handled. Raised once per gesture, with
+ * CONFIG_ZMK_SCROLL_SNAP_GESTURE_EVENTS=y.
+ */
+struct zmk_scroll_snap_gesture_ended {
+    // Scroll snap instance whose gesture ended
+    const struct device *dev;
+};
+
+ZMK_EVENT_DECLARE(zmk_scroll_snap_gesture_ended);
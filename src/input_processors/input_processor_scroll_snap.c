@@ -13,75 +13,614 @@
 #include <zephyr/sys/util.h>
 #include <zephyr/sys/util_macro.h>
 #include <drivers/input_processor.h>
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_BENCHMARK)
+#include <zephyr/timing/timing.h>
+#endif
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_STATS)
+#include <zephyr/stats/stats.h>
+#endif
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_TRACING)
+#include <zephyr/tracing/tracing.h>
+#endif
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_RUNTIME_TUNING)
+#include <zephyr/sys/atomic.h>
+#endif
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_RUNTIME_TUNING)
+#include <zephyr/sys/barrier.h>
+#endif
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_SHELL)
+#include <zephyr/shell/shell.h>
+#endif
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_SETTINGS)
+#include <zephyr/settings/settings.h>
+#endif
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_GESTURE_EVENTS)
+#include <scroll_snap/scroll_snap_gesture_ended.h>
+#endif
+#include <stddef.h>
 #include <stdlib.h>
 #include <errno.h>
 #include <limits.h>
+#include <stdio.h>
 #include <string.h>
 
-LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+// The core calls back into this file for statistics and direction logging
+#define SCROLL_SNAP_CORE_HOOKS
+#include <scroll_snap/scroll_snap_core.h>
+#include <scroll_snap/scroll_snap.h>
+
+LOG_MODULE_REGISTER(zmk_scroll_snap, CONFIG_ZMK_SCROLL_SNAP_LOG_LEVEL);
+
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_GESTURE_EVENTS)
+ZMK_EVENT_IMPL(zmk_scroll_snap_gesture_ended);
+#endif
 
 #if DT_HAS_COMPAT_STATUS_OKAY(DT_DRV_COMPAT)
 
-struct scroll_snap_sample {
-    int32_t dx;
-    int32_t dy;
+// The core's sample count reciprocals cover every window size
+BUILD_ASSERT(SCROLL_SNAP_RING_SIZE(CONFIG_ZMK_SCROLL_SNAP_MAX_BUF_SIZE) <= SCROLL_SNAP_SAMPLES_MAX,
+             "CONFIG_ZMK_SCROLL_SNAP_MAX_BUF_SIZE exceeds SCROLL_SNAP_SAMPLES_MAX");
+
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_TIME_SOURCE_CYCLES)
+#define SCROLL_SNAP_MS_TO_TICKS(ms)                                                                     \
+    ((uint32_t)(((uint64_t)(ms) * CONFIG_SYS_CLOCK_HW_CYCLES_PER_SEC + MSEC_PER_SEC - 1) / MSEC_PER_SEC))
+
+static inline scroll_snap_time_t scroll_snap_now(void) { return k_cycle_get_64(); }
+
+#define SCROLL_SNAP_TICKS_TIMEOUT(t) K_CYC(t)
+#else
+#define SCROLL_SNAP_MS_TO_TICKS(ms) ((uint32_t)(ms))
+
+static inline scroll_snap_time_t scroll_snap_now(void) { return k_uptime_get_32(); }
+
+#define SCROLL_SNAP_TICKS_TIMEOUT(t) K_MSEC(t)
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_BENCHMARK)
+// Cycle histogram buckets: two per power of two, so p99 is reported within ~1.5x
+#define SCROLL_SNAP_BENCH_BUCKETS 64
+
+struct scroll_snap_bench_stats {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+    uint32_t hist[SCROLL_SNAP_BENCH_BUCKETS];
 };
 
-#define DIRECTION_NONE 0
-#define DIRECTION_X 1
-#define DIRECTION_Y 2
-#define DIRECTION_DIAG_PLUS 3
-#define DIRECTION_DIAG_MINUS 4
+struct scroll_snap_bench {
+    uint32_t events;
+    struct scroll_snap_bench_stats paths[SCROLL_SNAP_PATH_COUNT];
+};
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_STATS)
+STATS_SECT_START(scroll_snap_stats)
+STATS_SECT_ENTRY32(snap_x)
+STATS_SECT_ENTRY32(snap_y)
+STATS_SECT_ENTRY32(snap_diag)
+STATS_SECT_ENTRY32(snap_none)
+STATS_SECT_ENTRY32(immediate_snaps)
+STATS_SECT_ENTRY32(warmup_swallowed)
+STATS_SECT_ENTRY32(speculative_snaps)
+STATS_SECT_ENTRY32(speculation_revised)
+STATS_SECT_ENTRY32(zero_suppressed)
+STATS_SECT_ENTRY32(locks_started)
+STATS_SECT_ENTRY32(locked_events)
+STATS_SECT_ENTRY32(lock_held_ticks)
+STATS_SECT_END;
 
+STATS_NAME_START(scroll_snap_stats)
+STATS_NAME(scroll_snap_stats, snap_x)
+STATS_NAME(scroll_snap_stats, snap_y)
+STATS_NAME(scroll_snap_stats, snap_diag)
+STATS_NAME(scroll_snap_stats, snap_none)
+STATS_NAME(scroll_snap_stats, immediate_snaps)
+STATS_NAME(scroll_snap_stats, warmup_swallowed)
+STATS_NAME(scroll_snap_stats, speculative_snaps)
+STATS_NAME(scroll_snap_stats, speculation_revised)
+STATS_NAME(scroll_snap_stats, zero_suppressed)
+STATS_NAME(scroll_snap_stats, locks_started)
+STATS_NAME(scroll_snap_stats, locked_events)
+STATS_NAME(scroll_snap_stats, lock_held_ticks)
+STATS_NAME_END(scroll_snap_stats);
+#endif
+
+// The core state is written by the event path, which may run in a sensor interrupt, and by the
+// expiry work under scroll_snap_core_lock. The shell and settings hand their changes over
+// through atomics instead of touching it.
 struct input_processor_scroll_snap_data {
-    uint16_t head;
-    struct scroll_snap_sample samples[CONFIG_ZMK_SCROLL_SNAP_MAX_BUF_SIZE];
-    uint16_t sample_count;
-    struct scroll_snap_sample sample_sum;
+#if !IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_SHARED_STATE)
+    struct scroll_snap_core core;
+#endif
+    const struct device *dev;
+#if CONFIG_ZMK_SCROLL_SNAP_LOG_LEVEL >= LOG_LEVEL_DBG
+    uint8_t logged_direction;
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_TIMER_EXPIRY)
+    struct k_work_delayable expiry_work;
+    // Set while the expiry work is scheduled or running, guarded by scroll_snap_core_lock
+    bool expiry_armed;
+#endif
 
-    struct scroll_snap_sample remainder;
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_GESTURE_EVENTS)
+    // Last event time a gesture end was raised for, guarded by scroll_snap_core_lock
+    scroll_snap_time_t gesture_reported;
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_BENCHMARK)
+    struct scroll_snap_bench bench;
+    // The last event, see zmk_scroll_snap_bench_last()
+    enum scroll_snap_path last_path;
+    uint32_t last_cycles;
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_STATS)
+    STATS_SECT_DECL(scroll_snap_stats) stats;
+#endif
 
-    int64_t last_event_ts_ms;
-    uint8_t lock_direction;
-    uint16_t lock_events_remaining;
-    int64_t lock_expires_at_ms;
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_RUNTIME_TUNING)
+    // Published parameters, double-buffered: slot (tuned_seq & 1) is the current one
+    struct scroll_snap_tuned tuned[2];
+    atomic_t tuned_seq;
+    // Copy of the published parameters the core reads, refreshed by the event path between
+    // events when the sequence moved
+    struct scroll_snap_tuned active;
+    atomic_val_t active_seq;
+    // The published parameters in devicetree units, guarded by scroll_snap_tuning_lock
+    struct zmk_scroll_snap_tuning tuning;
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_SETTINGS)
+    struct k_work_delayable save_work;
+#endif
 };
 
 struct input_processor_scroll_snap_config {
-    uint32_t x_thresh_num;
-    uint32_t x_thresh_den;
-    uint32_t y_thresh_num;
-    uint32_t y_thresh_den;
-    uint32_t xy_thresh_num;
-    uint32_t xy_thresh_den;
-
-    uint16_t require_n_samples;
-    uint32_t immediate_snap_threshold;
-    uint32_t lock_duration_ms;
-    uint16_t lock_for_next_n_events;
-    uint32_t idle_reset_timeout_ms;
+    // Durations in the parameters are in time source ticks, see SCROLL_SNAP_MS_TO_TICKS
+    struct scroll_snap_params params;
 
     uint8_t event_type;
     uint16_t event_code_x;
     uint16_t event_code_y;
-    bool track_remainders;
+
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_RUNTIME_TUNING)
+    // Devicetree defaults, and the largest require-n-samples the sample storage can hold
+    struct zmk_scroll_snap_tuning tuning;
+    uint16_t samples_max;
+#endif
 };
 
-static int input_processor_scroll_snap_init(const struct device *dev);
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_SHARED_STATE)
+// Decision state shared by all instances, owned by the instance that handled the last event
+static struct {
+    struct scroll_snap_core core;
+    struct input_processor_scroll_snap_data *owner;
+} scroll_snap_shared;
+#endif
 
-static int input_processor_scroll_snap_handle_event(const struct device *dev,
-                                                      struct input_event *event,
-                                                      uint32_t param1, uint32_t param2,
-                                                      struct zmk_input_processor_state *state) {
-    ARG_UNUSED(param1);
-    ARG_UNUSED(param2);
-    ARG_UNUSED(state);
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_TIMER_EXPIRY)
+// Keeps the event path and the expiry work off each other's core state. Held for one event or
+// one expiry check, both a few hundred cycles.
+static struct k_spinlock scroll_snap_core_lock;
+#endif
+
+static ALWAYS_INLINE k_spinlock_key_t scroll_snap_core_lock_take(void) {
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_TIMER_EXPIRY)
+    return k_spin_lock(&scroll_snap_core_lock);
+#else
+    return (k_spinlock_key_t){0};
+#endif
+}
+
+static ALWAYS_INLINE void scroll_snap_core_lock_give(k_spinlock_key_t key) {
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_TIMER_EXPIRY)
+    k_spin_unlock(&scroll_snap_core_lock, key);
+#else
+    ARG_UNUSED(key);
+#endif
+}
+
+static inline struct scroll_snap_core *
+scroll_snap_data_core(struct input_processor_scroll_snap_data *data) {
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_SHARED_STATE)
+    ARG_UNUSED(data);
+    return &scroll_snap_shared.core;
+#else
+    return &data->core;
+#endif
+}
+
+static inline struct input_processor_scroll_snap_data *
+scroll_snap_core_data(struct scroll_snap_core *core) {
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_SHARED_STATE)
+    ARG_UNUSED(core);
+    return scroll_snap_shared.owner;
+#else
+    return CONTAINER_OF(core, struct input_processor_scroll_snap_data, core);
+#endif
+}
+
+// Take over the shared state when another instance used it last, starting from a clean state
+// as after an idle reset
+static ALWAYS_INLINE void scroll_snap_acquire(struct input_processor_scroll_snap_data *data,
+                                              scroll_snap_time_t now) {
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_SHARED_STATE)
+    if (scroll_snap_shared.owner != data) {
+        scroll_snap_shared.owner = data;
+        scroll_snap_core_reset(&scroll_snap_shared.core);
+        scroll_snap_shared.core.last_event_ts = now;
+    }
+#else
+    ARG_UNUSED(data);
+    ARG_UNUSED(now);
+#endif
+}
+
+// Core hook: feed the decision counters into the stats group
+static inline void scroll_snap_core_count(struct scroll_snap_core *core, enum scroll_snap_stat stat,
+                                          uint32_t n) {
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_STATS)
+    struct input_processor_scroll_snap_data *data = scroll_snap_core_data(core);
+
+    switch (stat) {
+        case SCROLL_SNAP_STAT_SNAP_X:
+            STATS_INCN(data->stats, snap_x, n);
+            break;
+        case SCROLL_SNAP_STAT_SNAP_Y:
+            STATS_INCN(data->stats, snap_y, n);
+            break;
+        case SCROLL_SNAP_STAT_SNAP_DIAG:
+            STATS_INCN(data->stats, snap_diag, n);
+            break;
+        case SCROLL_SNAP_STAT_SNAP_NONE:
+            STATS_INCN(data->stats, snap_none, n);
+            break;
+        case SCROLL_SNAP_STAT_IMMEDIATE_SNAPS:
+            STATS_INCN(data->stats, immediate_snaps, n);
+            break;
+        case SCROLL_SNAP_STAT_WARMUP_SWALLOWED:
+            STATS_INCN(data->stats, warmup_swallowed, n);
+            break;
+        case SCROLL_SNAP_STAT_SPECULATIVE_SNAPS:
+            STATS_INCN(data->stats, speculative_snaps, n);
+            break;
+        case SCROLL_SNAP_STAT_SPECULATION_REVISED:
+            STATS_INCN(data->stats, speculation_revised, n);
+            break;
+        case SCROLL_SNAP_STAT_ZERO_SUPPRESSED:
+            STATS_INCN(data->stats, zero_suppressed, n);
+            break;
+        case SCROLL_SNAP_STAT_LOCKS_STARTED:
+            STATS_INCN(data->stats, locks_started, n);
+            break;
+        case SCROLL_SNAP_STAT_LOCKED_EVENTS:
+            STATS_INCN(data->stats, locked_events, n);
+            break;
+        case SCROLL_SNAP_STAT_LOCK_HELD_TICKS:
+            STATS_INCN(data->stats, lock_held_ticks, n);
+            break;
+        default:
+            break;
+    }
+#else
+    ARG_UNUSED(core);
+    ARG_UNUSED(stat);
+    ARG_UNUSED(n);
+#endif
+}
+
+// Core hook: log snap direction changes only, so debug logging does not flood at the sensor
+// report rate
+static inline void scroll_snap_core_decided(struct scroll_snap_core *core, uint8_t direction) {
+#if CONFIG_ZMK_SCROLL_SNAP_LOG_LEVEL >= LOG_LEVEL_DBG
+    static const char *const direction_names[] = {
+        [DIRECTION_NONE] = "none",
+        [DIRECTION_X] = "X axis",
+        [DIRECTION_Y] = "Y axis",
+        [DIRECTION_DIAG_PLUS] = "diagonal (+)",
+        [DIRECTION_DIAG_MINUS] = "diagonal (-)",
+    };
+    struct input_processor_scroll_snap_data *data = scroll_snap_core_data(core);
+
+    if (direction != data->logged_direction) {
+        data->logged_direction = direction;
+        LOG_DBG("%s: snapping to %s", data->dev->name, direction_names[direction]);
+    }
+#else
+    ARG_UNUSED(core);
+    ARG_UNUSED(direction);
+#endif
+}
+
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_RUNTIME_TUNING)
+// Serializes writers; the event path never takes it
+static K_MUTEX_DEFINE(scroll_snap_tuning_lock);
+
+static int scroll_snap_tuning_check(const struct input_processor_scroll_snap_config *config,
+                                    const struct zmk_scroll_snap_tuning *tuning) {
+    if (tuning->require_n_samples < 1 || tuning->require_n_samples > config->samples_max ||
+        tuning->lock_for_next_n_events > UINT16_MAX) {
+        return -EINVAL;
+    }
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_ACCUMULATOR_16BIT)
+    for (int i = 0; i < 2; i++) {
+        if (tuning->x_threshold[i] > UINT16_MAX || tuning->y_threshold[i] > UINT16_MAX ||
+            tuning->xy_threshold[i] > UINT16_MAX) {
+            return -EINVAL;
+        }
+    }
+#endif
+    // The direction LUT is generated from the devicetree thresholds at build time
+    if (config->params.direction_lut != NULL &&
+        (memcmp(tuning->x_threshold, config->tuning.x_threshold, sizeof(tuning->x_threshold)) != 0 ||
+         memcmp(tuning->y_threshold, config->tuning.y_threshold, sizeof(tuning->y_threshold)) != 0 ||
+         memcmp(tuning->xy_threshold, config->tuning.xy_threshold, sizeof(tuning->xy_threshold)) != 0)) {
+        return -ENOTSUP;
+    }
+    return 0;
+}
+
+// Write the parameters to the unused slot and switch readers over to it. Callers serialize on
+// scroll_snap_tuning_lock.
+static void scroll_snap_tuning_publish(struct input_processor_scroll_snap_data *data,
+                                       const struct input_processor_scroll_snap_config *config,
+                                       const struct zmk_scroll_snap_tuning *tuning) {
+    atomic_val_t seq = atomic_get(&data->tuned_seq) + 1;
+    struct scroll_snap_tuned *tuned = &data->tuned[seq & 1];
+    uint16_t samples = tuning->require_n_samples;
+    uint32_t lock_duration = SCROLL_SNAP_MS_TO_TICKS(tuning->lock_duration_ms);
+    uint16_t lock_events = tuning->lock_for_next_n_events;
+    uint32_t idle_reset_timeout = SCROLL_SNAP_MS_TO_TICKS(tuning->idle_reset_timeout_ms);
 
+    if (config->params.estimator != SCROLL_SNAP_ESTIMATOR_EMA) {
+        samples = SCROLL_SNAP_RING_SIZE(samples);
+    }
+    // Locks stay off while a hysteresis hold is configured, as in devicetree
+    if (config->params.hysteresis_num > 0) {
+        lock_duration = config->params.lock_duration;
+        lock_events = config->params.lock_for_next_n_events;
+    }
+
+    *tuned = (struct scroll_snap_tuned){
+        .x_thresh_num = tuning->x_threshold[0],
+        .x_thresh_den = tuning->x_threshold[1],
+        .y_thresh_num = tuning->y_threshold[0],
+        .y_thresh_den = tuning->y_threshold[1],
+        .xy_thresh_num = tuning->xy_threshold[0],
+        .xy_thresh_den = tuning->xy_threshold[1],
+        .immediate_snap_threshold = tuning->immediate_snap_threshold,
+        .lock_duration = lock_duration,
+        .idle_reset_timeout = idle_reset_timeout,
+        .require_n_samples = samples,
+        .velocity_fast_samples = MIN(config->params.velocity_fast_samples, samples),
+        .lock_for_next_n_events = lock_events,
+        .uses_time =
+            config->params.sample_window > 0 || lock_duration > 0 || idle_reset_timeout > 0,
+    };
+    barrier_dmem_fence_full();
+    atomic_set(&data->tuned_seq, seq);
+    data->tuning = *tuning;
+
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_TIMER_EXPIRY)
+    // Have a running work check the deadlines against the new durations right away. A stopped
+    // work is armed by the next event.
+    k_spinlock_key_t key = scroll_snap_core_lock_take();
+
+    if (data->expiry_armed) {
+        k_work_reschedule(&data->expiry_work, K_NO_WAIT);
+    }
+    scroll_snap_core_lock_give(key);
+#endif
+}
+
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_SETTINGS)
+#define SCROLL_SNAP_SETTINGS_ROOT "scroll_snap"
+
+static void scroll_snap_settings_key(const struct device *dev, char *key, size_t size) {
+    snprintf(key, size, SCROLL_SNAP_SETTINGS_ROOT "/%s", dev->name);
+}
+
+// Write the tuned parameters once changes have settled, so flash writes stay off the input path.
+// A set equal to the devicetree defaults is deleted, so later devicetree changes apply again.
+static void scroll_snap_save_work_cb(struct k_work *work) {
+    struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+    struct input_processor_scroll_snap_data *data =
+        CONTAINER_OF(dwork, struct input_processor_scroll_snap_data, save_work);
+    const struct input_processor_scroll_snap_config *config = data->dev->config;
+    char key[SETTINGS_MAX_NAME_LEN + 1];
+    struct zmk_scroll_snap_tuning tuning;
+    int err;
+
+    k_mutex_lock(&scroll_snap_tuning_lock, K_FOREVER);
+    tuning = data->tuning;
+    k_mutex_unlock(&scroll_snap_tuning_lock);
+
+    scroll_snap_settings_key(data->dev, key, sizeof(key));
+    if (memcmp(&tuning, &config->tuning, sizeof(tuning)) == 0) {
+        err = settings_delete(key);
+    } else {
+        err = settings_save_one(key, &tuning, sizeof(tuning));
+    }
+    if (err < 0) {
+        LOG_ERR("%s: failed to save parameters (%d)", data->dev->name, err);
+    }
+}
+
+// Replace the devicetree defaults with the saved parameters of one instance
+static int scroll_snap_settings_apply(const struct device *dev, size_t len,
+                                      settings_read_cb read_cb, void *cb_arg) {
     struct input_processor_scroll_snap_data *data = dev->data;
-    const struct input_processor_scroll_snap_config *config = dev->config;
+    struct zmk_scroll_snap_tuning tuning;
+
+    if (len != sizeof(tuning) || read_cb(cb_arg, &tuning, sizeof(tuning)) != sizeof(tuning)) {
+        LOG_WRN("%s: ignoring saved parameters of unexpected size", dev->name);
+        return 0;
+    }
+    int err = scroll_snap_tuning_check(dev->config, &tuning);
+
+    if (err < 0) {
+        LOG_WRN("%s: ignoring saved parameters that do not fit the instance (%d)", dev->name, err);
+        return 0;
+    }
+
+    k_mutex_lock(&scroll_snap_tuning_lock, K_FOREVER);
+    scroll_snap_tuning_publish(data, dev->config, &tuning);
+    k_mutex_unlock(&scroll_snap_tuning_lock);
+    return 0;
+}
+#endif
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_RUNTIME_TUNING)
+// Copy the published parameters. A slot is only rewritten after a publish to the other one, so a
+// copy taken while the sequence did not move is consistent.
+static inline atomic_val_t scroll_snap_tuning_read(struct input_processor_scroll_snap_data *data,
+                                                   struct scroll_snap_tuned *tuned) {
+    atomic_val_t seq;
+
+    do {
+        seq = atomic_get(&data->tuned_seq);
+        *tuned = data->tuned[seq & 1];
+        barrier_dmem_fence_full();
+    } while (atomic_get(&data->tuned_seq) != seq);
+    return seq;
+}
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_RUNTIME_TUNING)
+// Whether a lock taken under old parameters no longer matches new ones. A lock the new lock
+// settings could not end, e.g. with both set to 0, would otherwise hold its direction for good.
+static inline bool scroll_snap_tuned_lock_changed(const struct scroll_snap_tuned *old,
+                                                  const struct scroll_snap_tuned *tuned) {
+    return old->x_thresh_num != tuned->x_thresh_num || old->x_thresh_den != tuned->x_thresh_den ||
+           old->y_thresh_num != tuned->y_thresh_num || old->y_thresh_den != tuned->y_thresh_den ||
+           old->xy_thresh_num != tuned->xy_thresh_num ||
+           old->xy_thresh_den != tuned->xy_thresh_den ||
+           old->lock_duration != tuned->lock_duration ||
+           old->lock_for_next_n_events != tuned->lock_for_next_n_events;
+}
+#endif
+
+// Take over newly published parameters before an event, so a change never takes effect halfway
+// through one. Events only pay for a sequence check; the core reads the active copy in place.
+// Sample collection restarts when the window size changed, as ring positions and sums no longer
+// match it, and a held lock is released when the thresholds or lock settings changed. Called
+// with the core state held, see scroll_snap_core_lock.
+static ALWAYS_INLINE void scroll_snap_tuning_sync(struct input_processor_scroll_snap_data *data) {
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_RUNTIME_TUNING)
+    if (atomic_get(&data->tuned_seq) == data->active_seq) {
+        return;
+    }
+
+    const struct input_processor_scroll_snap_config *config = data->dev->config;
+    struct scroll_snap_core *core = scroll_snap_data_core(data);
+    struct scroll_snap_tuned old = data->active;
+
+    data->active_seq = scroll_snap_tuning_read(data, &data->active);
+    // A shared state owned by another instance is reset when this one takes it over
+    if (scroll_snap_core_data(core) != data) {
+        return;
+    }
+    if (data->active.require_n_samples != old.require_n_samples) {
+        scroll_snap_core_lock_end(core, &config->params, scroll_snap_now());
+        scroll_snap_core_reset(core);
+    } else if (core->lock_direction != DIRECTION_NONE &&
+               scroll_snap_tuned_lock_changed(&old, &data->active)) {
+        scroll_snap_core_release_lock(core, &config->params, scroll_snap_now());
+    }
+#else
+    ARG_UNUSED(data);
+#endif
+}
+
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_TIMER_EXPIRY)
+// Applies the idle reset and lock expiry once their deadline passed, and looks again at the
+// next one while motion goes on. Stops once nothing is pending; the next event arms it again.
+static void scroll_snap_expiry_work_cb(struct k_work *work) {
+    struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+    struct input_processor_scroll_snap_data *data =
+        CONTAINER_OF(dwork, struct input_processor_scroll_snap_data, expiry_work);
+    const struct input_processor_scroll_snap_config *config = data->dev->config;
+    const struct scroll_snap_params *params = &config->params;
+    struct scroll_snap_core *core = scroll_snap_data_core(data);
+    uint32_t next = UINT32_MAX;
+    bool ended = false;
+    k_spinlock_key_t key = scroll_snap_core_lock_take();
+
+    scroll_snap_tuning_sync(data);
+    uint32_t delay = scroll_snap_core_expiry_delay(params);
 
+    // A shared state taken over by another instance is watched by that instance's work
+    if (delay > 0 && scroll_snap_core_data(core) == data) {
+        scroll_snap_time_t now = scroll_snap_now();
+        scroll_snap_time_t last = core->last_event_ts;
+        uint32_t idle = scroll_snap_elapsed(now, last);
+
+        next = scroll_snap_core_expire(core, params, now);
+        if (idle < delay) {
+            // Motion went on; look again once it could have stopped for the whole delay
+            next = MIN(next, delay - idle);
+        }
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_GESTURE_EVENTS)
+        // The work can see the same last event again after tuning; report each gesture once
+        if (idle >= delay && last != data->gesture_reported) {
+            data->gesture_reported = last;
+            ended = true;
+        }
+#endif
+    }
+
+    if (next == UINT32_MAX) {
+        data->expiry_armed = false;
+    } else {
+        k_work_reschedule(dwork, SCROLL_SNAP_TICKS_TIMEOUT(next));
+    }
+    scroll_snap_core_lock_give(key);
+
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_GESTURE_EVENTS)
+    if (ended) {
+        raise_zmk_scroll_snap_gesture_ended(
+            (struct zmk_scroll_snap_gesture_ended){.dev = data->dev});
+    }
+#else
+    ARG_UNUSED(ended);
+#endif
+}
+#endif
+
+// Apply idle reset and lock expiry ahead of new motion
+static ALWAYS_INLINE void scroll_snap_expiry(struct input_processor_scroll_snap_data *data,
+                                             const struct scroll_snap_params *params,
+                                             scroll_snap_time_t now) {
+    if (SCROLL_SNAP_TUNED(params, idle_reset_timeout) == 0 &&
+        SCROLL_SNAP_TUNED(params, lock_duration) == 0) {
+        return;
+    }
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_TIMER_EXPIRY)
+    // The work applies the deadlines; the event only moves them by updating the core state, and
+    // starts the work when it stopped after the previous gesture. A time lock that runs out
+    // before the work sees it is released by the snap decision itself.
+    ARG_UNUSED(now);
+    if (!data->expiry_armed) {
+        data->expiry_armed = true;
+        k_work_schedule(&data->expiry_work,
+                        SCROLL_SNAP_TICKS_TIMEOUT(scroll_snap_core_expiry_delay(params)));
+    }
+#else
+    // Idle reset and lock expiry are applied lazily, on the next event
+    scroll_snap_core_expire(scroll_snap_data_core(data), params, now);
+#endif
+}
+
+// Always inlined so per-instance handlers get their config as compile-time constants
+static ALWAYS_INLINE int scroll_snap_process(struct input_processor_scroll_snap_data *data,
+                                             const struct input_processor_scroll_snap_config *config,
+                                             struct input_event *event, enum scroll_snap_path *path) {
     // Check if event type matches configured type
     if (event->type != config->event_type) {
+        *path = SCROLL_SNAP_PATH_IGNORED;
         return ZMK_INPUT_PROC_CONTINUE;
     }
 
@@ -90,217 +629,614 @@ static int input_processor_scroll_snap_handle_event(const struct device *dev,
     bool is_y_axis = (event->code == config->event_code_y);
 
     if (!is_x_axis && !is_y_axis) {
+        *path = SCROLL_SNAP_PATH_IGNORED;
         return ZMK_INPUT_PROC_CONTINUE;
     }
 
-    // Reset after inactivity timeout
-    int64_t now_ms = k_uptime_get();
-    if (config->idle_reset_timeout_ms > 0) {
-        int64_t elapsed = now_ms - data->last_event_ts_ms;
-        if (elapsed >= config->idle_reset_timeout_ms) {
-            input_processor_scroll_snap_init(dev);
-        }
-    }
+    const struct scroll_snap_params *params = &config->params;
+    k_spinlock_key_t key = scroll_snap_core_lock_take();
 
-    data->last_event_ts_ms = now_ms;
+    scroll_snap_tuning_sync(data);
+    scroll_snap_time_t now = SCROLL_SNAP_TUNED(params, uses_time) ? scroll_snap_now() : 0;
 
-    // Expire time-based lock
-    if (data->lock_direction != DIRECTION_NONE && config->lock_duration_ms > 0 && data->lock_expires_at_ms > 0) {
-        if (now_ms >= data->lock_expires_at_ms) {
-            data->lock_direction = DIRECTION_NONE;
-            data->lock_expires_at_ms = 0;
-            data->lock_events_remaining = 0;
-        }
+    scroll_snap_acquire(data, now);
+    scroll_snap_expiry(data, params, now);
+
+    struct scroll_snap_event ev = {
+        .value = event->value,
+        .is_x_axis = is_x_axis,
+        .sync = event->sync,
+    };
+    bool forward = scroll_snap_core_process(scroll_snap_data_core(data), params, &ev, now, path);
+
+    scroll_snap_core_lock_give(key);
+
+    event->code = ev.is_x_axis ? config->event_code_x : config->event_code_y;
+    event->value = ev.value;
+    event->sync = ev.sync;
+    return forward ? ZMK_INPUT_PROC_CONTINUE : ZMK_INPUT_PROC_STOP;
+}
+
+int zmk_scroll_snap_process_burst(const struct device *dev, const struct scroll_snap_delta *deltas,
+                                  size_t count, int32_t *dx, int32_t *dy) {
+    struct input_processor_scroll_snap_data *data = dev->data;
+    const struct input_processor_scroll_snap_config *config = dev->config;
+    const struct scroll_snap_params *params = &config->params;
+
+    if (count == 0) {
+        return -EINVAL;
     }
 
-    // Accumulate samples using ring buffer
-    struct scroll_snap_sample incoming = { .dx = 0, .dy = 0 };
-    if (is_x_axis) {
-        incoming.dx = event->value;
-    } else if (is_y_axis) {
-        incoming.dy = event->value;
+    int32_t sum_x = 0, sum_y = 0;
+    for (size_t i = 0; i < count; i++) {
+        sum_x += deltas[i].dx;
+        sum_y += deltas[i].dy;
     }
 
-    // When buffer is full, delete the oldest sample
-    if (data->sample_count >= config->require_n_samples) {
-        struct scroll_snap_sample old = data->samples[data->head];
-        data->sample_sum.dx -= abs(old.dx);
-        data->sample_sum.dy -= abs(old.dy);
+    enum scroll_snap_path path;
+    k_spinlock_key_t key = scroll_snap_core_lock_take();
+
+    scroll_snap_tuning_sync(data);
+    scroll_snap_time_t now = SCROLL_SNAP_TUNED(params, uses_time) ? scroll_snap_now() : 0;
+
+    scroll_snap_acquire(data, now);
+    scroll_snap_expiry(data, params, now);
+    bool forward = scroll_snap_core_process_frame(scroll_snap_data_core(data), params, &sum_x, &sum_y,
+                                                  now, &path);
+
+    scroll_snap_core_lock_give(key);
+
+    *dx = sum_x;
+    *dy = sum_y;
+    return forward ? 0 : -EAGAIN;
+}
+
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_RUNTIME_TUNING)
+int zmk_scroll_snap_get_tuning(const struct device *dev, struct zmk_scroll_snap_tuning *tuning) {
+    struct input_processor_scroll_snap_data *data = dev->data;
+
+    k_mutex_lock(&scroll_snap_tuning_lock, K_FOREVER);
+    *tuning = data->tuning;
+    k_mutex_unlock(&scroll_snap_tuning_lock);
+    return 0;
+}
+
+int zmk_scroll_snap_set_tuning(const struct device *dev,
+                               const struct zmk_scroll_snap_tuning *tuning) {
+    const struct input_processor_scroll_snap_config *config = dev->config;
+    int err = scroll_snap_tuning_check(config, tuning);
+
+    if (err < 0) {
+        return err;
     }
 
-    data->samples[data->head] = incoming;
-    data->sample_sum.dx += abs(incoming.dx);
-    data->sample_sum.dy += abs(incoming.dy);
-    data->remainder.dx += incoming.dx;
-    data->remainder.dy += incoming.dy;
-    data->sample_count++;
-    data->head = (data->head + 1) % config->require_n_samples;
+    k_mutex_lock(&scroll_snap_tuning_lock, K_FOREVER);
+    scroll_snap_tuning_publish(dev->data, config, tuning);
+    k_mutex_unlock(&scroll_snap_tuning_lock);
 
-    uint16_t abs_x = (uint16_t)(data->sample_sum.dx);
-    uint16_t abs_y = (uint16_t)(data->sample_sum.dy);
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_SETTINGS)
+    struct input_processor_scroll_snap_data *data = dev->data;
 
-    // Check if we have enough samples
-    if (!(data->sample_count >= config->require_n_samples || abs_x > config->immediate_snap_threshold || abs_y > config->immediate_snap_threshold)) {
-        event->value = 0;
-        event->sync = false;
-        return ZMK_INPUT_PROC_STOP;
+    k_work_reschedule(&data->save_work, K_MSEC(CONFIG_ZMK_SCROLL_SNAP_SETTINGS_SAVE_DEBOUNCE));
+#endif
+    return 0;
+}
+
+int zmk_scroll_snap_reset_tuning(const struct device *dev) {
+    const struct input_processor_scroll_snap_config *config = dev->config;
+
+    return zmk_scroll_snap_set_tuning(dev, &config->tuning);
+}
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_BENCHMARK)
+static uint8_t scroll_snap_bench_bucket(uint32_t cycles) {
+    if (cycles < 2) {
+        return 0;
     }
+    uint8_t msb = 31 - __builtin_clz(cycles);
+    return MIN((msb << 1) | ((cycles >> (msb - 1)) & 1), SCROLL_SNAP_BENCH_BUCKETS - 1);
+}
 
-    int32_t new_x = 0, new_y = 0;
-    uint8_t detected_direction = DIRECTION_NONE;
+static uint32_t scroll_snap_bench_bucket_upper(uint8_t bucket) {
+    uint8_t msb = bucket >> 1;
+    if (msb == 0) {
+        return 1;
+    }
+    uint64_t upper = ((uint64_t)(2 | (bucket & 1)) << (msb - 1)) + (1ULL << (msb - 1)) - 1;
+    return (uint32_t)MIN(upper, UINT32_MAX);
+}
 
-    // Detect direction from thresholds
-    if (abs_y * config->y_thresh_den > abs_x * config->y_thresh_num) {
-        detected_direction = DIRECTION_Y;
-    } else if (abs_y * config->x_thresh_den < abs_x * config->x_thresh_num) {
-        detected_direction = DIRECTION_X;
-    } else if (abs_x * config->xy_thresh_num < abs_y * config->xy_thresh_den &&
-               abs_y * config->xy_thresh_num < abs_x * config->xy_thresh_den) {
-        detected_direction = ((data->remainder.dx > 0) == (data->remainder.dy > 0)) ? DIRECTION_DIAG_PLUS : DIRECTION_DIAG_MINUS;
-    } else {
-        detected_direction = DIRECTION_NONE;
+static uint32_t scroll_snap_bench_p99(const struct scroll_snap_bench_stats *stats) {
+    // Walk down from the slowest bucket until 1% of the samples are above us
+    uint32_t allowed = stats->count / 100;
+    uint32_t seen = 0;
+    for (int i = SCROLL_SNAP_BENCH_BUCKETS - 1; i >= 0; i--) {
+        seen += stats->hist[i];
+        if (seen > allowed) {
+            return MIN(scroll_snap_bench_bucket_upper(i), stats->max);
+        }
     }
+    return 0;
+}
+
+static void scroll_snap_bench_record(const struct device *dev, enum scroll_snap_path path,
+                                     uint32_t cycles) {
+    static const char *const path_names[SCROLL_SNAP_PATH_COUNT] = {
+        [SCROLL_SNAP_PATH_IGNORED] = "ignored",
+        [SCROLL_SNAP_PATH_ACCUMULATE] = "accumulate",
+        [SCROLL_SNAP_PATH_DECIDE] = "decide",
+        [SCROLL_SNAP_PATH_LOCKED] = "locked",
+        [SCROLL_SNAP_PATH_FAST] = "fast",
+    };
+    struct input_processor_scroll_snap_data *data = dev->data;
+    struct scroll_snap_bench *bench = &data->bench;
+    struct scroll_snap_bench_stats *stats = &bench->paths[path];
 
-    // Check if lock is active
-    bool is_lock_active = false;
-    if (config->lock_duration_ms > 0) {
-        is_lock_active = (data->lock_direction != DIRECTION_NONE) && (data->lock_expires_at_ms > now_ms);
+    if (stats->count == 0 || cycles < stats->min) {
+        stats->min = cycles;
     }
-    is_lock_active |= (data->lock_events_remaining > 0);
+    if (cycles > stats->max) {
+        stats->max = cycles;
+    }
+    stats->count++;
+    stats->total += cycles;
+    stats->hist[scroll_snap_bench_bucket(cycles)]++;
 
-    // Snap to the decided direction
-    uint8_t decided_direction = is_lock_active ? data->lock_direction : detected_direction;
-    switch (decided_direction) {
-        case DIRECTION_X:
-            LOG_DBG("Snapping to X axis");
-            new_x = data->remainder.dx;
-            new_y = 0;
-            data->remainder.dy = 0;
-            break;
-        case DIRECTION_Y:
-            LOG_DBG("Snapping to Y axis");
-            new_y = data->remainder.dy;
-            new_x = 0;
-            data->remainder.dx = 0;
-            break;
-        case DIRECTION_DIAG_PLUS:
-            LOG_DBG("Snapping to Diagonal (+)");
-            // TODO !!
-            break;
-        case DIRECTION_DIAG_MINUS:
-            LOG_DBG("Snapping to Diagonal (-)");
-            // TODO !!
-            break;
-        default:
-            new_x = 0;
-            new_y = 0;
-            break;
+    if (++bench->events < CONFIG_ZMK_SCROLL_SNAP_BENCHMARK_REPORT_INTERVAL) {
+        return;
     }
 
-    // Modify the current event to be the snapped scroll version and clear remainders
-    if (is_y_axis) {
-        event->value = new_y;
-        data->remainder.dy = 0;
-    } else if (is_x_axis) {
-        event->value = new_x;
-        data->remainder.dx = 0;
-    }
-
-    // Lock handling: start/refresh/decrement
-    if (config->lock_duration_ms > 0 || config->lock_for_next_n_events > 0) {
-        if (is_lock_active) {
-            // Refresh when detected direction matches current lock
-            if (detected_direction != DIRECTION_NONE && detected_direction == data->lock_direction) {
-                if (config->lock_duration_ms > 0) {
-                    data->lock_expires_at_ms = now_ms + (int64_t)config->lock_duration_ms;
-                }
-                if (config->lock_for_next_n_events > 0) {
-                    data->lock_events_remaining = config->lock_for_next_n_events;
-                }
-            } else {
-                // No refresh: decrement event-based lock
-                if (config->lock_duration_ms == 0 && config->lock_for_next_n_events > 0) {
-                    if (data->lock_events_remaining > 0) {
-                        data->lock_events_remaining--;
-                        if (data->lock_events_remaining == 0) {
-                            data->lock_direction = DIRECTION_NONE;
-                        }
-                    }
-                }
-            }
-        } else if (decided_direction != DIRECTION_NONE) {
-            // Start a new lock
-            if (config->lock_duration_ms > 0) {
-                data->lock_direction = decided_direction;
-                data->lock_expires_at_ms = now_ms + (int64_t)config->lock_duration_ms;
-                data->lock_events_remaining = 0;
-            }
-            if (config->lock_for_next_n_events > 0) {
-                data->lock_direction = decided_direction;
-                data->lock_events_remaining = config->lock_for_next_n_events;
-            }
-        } else {
-            // No locking configured or no decision
-            if (config->lock_duration_ms == 0 && config->lock_for_next_n_events == 0) {
-                data->lock_direction = DIRECTION_NONE;
-                data->lock_events_remaining = 0;
-                data->lock_expires_at_ms = 0;
-            }
+    for (int i = SCROLL_SNAP_PATH_ACCUMULATE; i < SCROLL_SNAP_PATH_COUNT; i++) {
+        const struct scroll_snap_bench_stats *s = &bench->paths[i];
+        if (s->count == 0) {
+            continue;
         }
+        LOG_INF("%s %s: n=%u min=%u avg=%u p99=%u max=%u cycles", dev->name, path_names[i],
+                s->count, s->min, (uint32_t)(s->total / s->count), scroll_snap_bench_p99(s),
+                s->max);
+    }
+    memset(bench, 0, sizeof(*bench));
+}
+
+int zmk_scroll_snap_bench_last(const struct device *dev, enum scroll_snap_path *path,
+                               uint32_t *cycles) {
+    const struct input_processor_scroll_snap_data *data = dev->data;
+
+    *path = data->last_path;
+    *cycles = data->last_cycles;
+    return 0;
+}
+#endif
+
+static ALWAYS_INLINE int scroll_snap_handle(const struct device *dev,
+                                            struct input_processor_scroll_snap_data *data,
+                                            const struct input_processor_scroll_snap_config *config,
+                                            struct input_event *event) {
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_TRACING)
+    sys_trace_named_event("scroll_snap_enter", event->code, event->value);
+#endif
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_BENCHMARK)
+    timing_t start = timing_counter_get();
+#endif
+
+    enum scroll_snap_path path;
+    int ret = scroll_snap_process(data, config, event, &path);
+
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_BENCHMARK)
+    timing_t end = timing_counter_get();
+    uint32_t cycles = (uint32_t)timing_cycles_get(&start, &end);
+
+    data->last_path = path;
+    data->last_cycles = cycles;
+    if (path != SCROLL_SNAP_PATH_IGNORED) {
+        scroll_snap_bench_record(dev, path, cycles);
     }
+#endif
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_TRACING)
+    sys_trace_named_event("scroll_snap_exit", path, event->value);
+#endif
 
-    return ZMK_INPUT_PROC_CONTINUE;
+    return ret;
 }
 
 static int input_processor_scroll_snap_init(const struct device *dev) {
     struct input_processor_scroll_snap_data *data = dev->data;
+
+    data->dev = dev;
+    scroll_snap_core_reset(scroll_snap_data_core(data));
+    scroll_snap_data_core(data)->last_event_ts = scroll_snap_now();
+
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_RUNTIME_TUNING)
     const struct input_processor_scroll_snap_config *config = dev->config;
 
-    data->sample_count = 0;
-    data->sample_sum.dx = 0;
-    data->sample_sum.dy = 0;
-    data->remainder.dx = 0;
-    data->remainder.dy = 0;
-    data->head = 0;
-    data->last_event_ts_ms = k_uptime_get();
-    data->lock_events_remaining = 0;
-    data->lock_direction = DIRECTION_NONE;
-    data->lock_expires_at_ms = 0;
+    scroll_snap_tuning_publish(data, config, &config->tuning);
+    data->active_seq = scroll_snap_tuning_read(data, &data->active);
+#endif
 
-    memset(data->samples, 0, sizeof(struct scroll_snap_sample) * config->require_n_samples);
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_SETTINGS)
+    k_work_init_delayable(&data->save_work, scroll_snap_save_work_cb);
+#endif
 
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_TIMER_EXPIRY)
+    k_work_init_delayable(&data->expiry_work, scroll_snap_expiry_work_cb);
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_GESTURE_EVENTS)
+    // No gesture before the first event
+    data->gesture_reported = scroll_snap_data_core(data)->last_event_ts;
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_STATS)
+    stats_init(&data->stats.s_hdr, STATS_SIZE_32,
+               (sizeof(data->stats) - sizeof(struct stats_hdr)) / sizeof(uint32_t),
+               STATS_NAME_INIT_PARMS(scroll_snap_stats));
+    stats_register(dev->name, &data->stats.s_hdr);
+#endif
+
+    return 0;
+}
+
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_BENCHMARK)
+static int scroll_snap_bench_init(void) {
+    timing_init();
+    timing_start();
     return 0;
 }
 
+SYS_INIT(scroll_snap_bench_init, POST_KERNEL, CONFIG_KERNEL_INIT_PRIORITY_DEFAULT);
+#endif
+
+#if !IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_SPECIALIZE_INSTANCES)
+static int input_processor_scroll_snap_handle_event(const struct device *dev,
+                                                      struct input_event *event,
+                                                      uint32_t param1, uint32_t param2,
+                                                      struct zmk_input_processor_state *state) {
+    ARG_UNUSED(param1);
+    ARG_UNUSED(param2);
+    ARG_UNUSED(state);
+
+    return scroll_snap_handle(dev, dev->data, dev->config, event);
+}
+
 static const struct zmk_input_processor_driver_api input_processor_scroll_snap_driver_api = {
     .handle_event = input_processor_scroll_snap_handle_event,
 };
+#endif
+
+#define SCROLL_SNAP_INST_IS_EMA(n) DT_INST_ENUM_HAS_VALUE(n, estimator, ema)
+
+#define SCROLL_SNAP_INST_HAS_LUT(n) DT_INST_ENUM_HAS_VALUE(n, classifier, lut)
+
+// Property accessors of SCROLL_SNAP_PARAMS_INIT() for devicetree instances
+#define SCROLL_SNAP_INST_PROP(n, prop) DT_INST_PROP_OR(n, prop, 0)
+#define SCROLL_SNAP_INST_PROP_IDX(n, prop, idx)                                                         \
+    COND_CODE_1(DT_INST_NODE_HAS_PROP(n, prop), (DT_INST_PROP_BY_IDX(n, prop, idx)), (0))
+
+#define SCROLL_SNAP_INST_N_SAMPLES(n)                                                                   \
+    SCROLL_SNAP_PARAMS_N_SAMPLES(SCROLL_SNAP_INST_PROP, n, CONFIG_ZMK_SCROLL_SNAP_MAX_BUF_SIZE)
+
+#define SCROLL_SNAP_INST_RING_SIZE(n) SCROLL_SNAP_RING_SIZE(SCROLL_SNAP_INST_N_SAMPLES(n))
+
+// Per-sample timestamps are only needed to age out window samples by time
+#define SCROLL_SNAP_INST_HAS_SAMPLE_TS(n)                                                               \
+    COND_CODE_1(SCROLL_SNAP_INST_IS_EMA(n), (0), (DT_INST_NODE_HAS_PROP(n, sample_window_ms)))
+
+#define SCROLL_SNAP_INST_HAS_HYSTERESIS(n) DT_INST_NODE_HAS_PROP(n, hysteresis_threshold)
+
+#define SCROLL_SNAP_INST_HAS_SPECULATIVE(n) DT_INST_NODE_HAS_PROP(n, speculative_threshold)
+
+#define SCROLL_SNAP_INST_LOCK_DURATION_MS(n)                                                            \
+    SCROLL_SNAP_PARAMS_LOCK(SCROLL_SNAP_INST_PROP, SCROLL_SNAP_INST_PROP_IDX, n, lock_duration_ms)
+
+#define SCROLL_SNAP_INST_LOCK_EVENTS(n)                                                                 \
+    SCROLL_SNAP_PARAMS_LOCK(SCROLL_SNAP_INST_PROP, SCROLL_SNAP_INST_PROP_IDX, n, lock_for_next_n_events)
+
+// The 16-bit kernel multiplies 16-bit magnitudes by threshold terms in 32 bits
+#define SCROLL_SNAP_INST_CHECK_THRESHOLD(n, prop)                                                       \
+    BUILD_ASSERT(!IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_ACCUMULATOR_16BIT) ||                               \
+                     (DT_INST_PROP_BY_IDX(n, prop, 0) <= UINT16_MAX &&                                  \
+                      DT_INST_PROP_BY_IDX(n, prop, 1) <= UINT16_MAX),                                   \
+                 "Threshold terms must fit 16 bits with CONFIG_ZMK_SCROLL_SNAP_ACCUMULATOR_16BIT");
+
+// Handler specialized for one instance: the core is inlined against this instance's const config,
+// so disabled lock modes and unused threshold checks fold away
+#define SCROLL_SNAP_INST_HANDLER(n)                                                                     \
+    static int input_processor_scroll_snap_handle_event_##n(                                            \
+        const struct device *dev, struct input_event *event, uint32_t param1, uint32_t param2,          \
+        struct zmk_input_processor_state *state) {                                                      \
+        ARG_UNUSED(param1);                                                                             \
+        ARG_UNUSED(param2);                                                                             \
+        ARG_UNUSED(state);                                                                              \
+        return scroll_snap_handle(dev, &input_processor_scroll_snap_data_##n,                           \
+                                  &input_processor_scroll_snap_config_##n, event);                      \
+    }                                                                                                   \
+    static const struct zmk_input_processor_driver_api input_processor_scroll_snap_driver_api_##n = {   \
+        .handle_event = input_processor_scroll_snap_handle_event_##n,                                   \
+    };
+
+#define SCROLL_SNAP_INST_PARAMS(n)                                                                      \
+    SCROLL_SNAP_PARAMS_INIT(                                                                            \
+        SCROLL_SNAP_INST_PROP, SCROLL_SNAP_INST_PROP_IDX, n, SCROLL_SNAP_INST_IS_EMA(n),                \
+        CONFIG_ZMK_SCROLL_SNAP_MAX_BUF_SIZE, SCROLL_SNAP_MS_TO_TICKS,                                   \
+        COND_CODE_1(SCROLL_SNAP_INST_IS_EMA(n), (NULL), (SCROLL_SNAP_INST_SAMPLES(n))),                 \
+        COND_CODE_1(SCROLL_SNAP_INST_HAS_SAMPLE_TS(n), (SCROLL_SNAP_INST_SAMPLE_TS(n)), (NULL)),        \
+        COND_CODE_1(SCROLL_SNAP_INST_HAS_LUT(n), (input_processor_scroll_snap_lut_##n), (NULL)),        \
+        IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_LOCK_FAST_PATH),                                              \
+        COND_CODE_1(CONFIG_ZMK_SCROLL_SNAP_RUNTIME_TUNING,                                              \
+                    (.tuned = &input_processor_scroll_snap_data_##n.active,), ()))
+
+// Devicetree defaults of the runtime-tunable parameters
+#define SCROLL_SNAP_INST_TUNING(n)                                                                      \
+    {                                                                                                   \
+        .x_threshold = {DT_INST_PROP_BY_IDX(n, x_threshold, 0),                                         \
+                        DT_INST_PROP_BY_IDX(n, x_threshold, 1)},                                        \
+        .y_threshold = {DT_INST_PROP_BY_IDX(n, y_threshold, 0),                                         \
+                        DT_INST_PROP_BY_IDX(n, y_threshold, 1)},                                        \
+        .xy_threshold = {DT_INST_PROP_BY_IDX(n, xy_threshold, 0),                                       \
+                         DT_INST_PROP_BY_IDX(n, xy_threshold, 1)},                                      \
+        .require_n_samples = SCROLL_SNAP_INST_N_SAMPLES(n),                                             \
+        .immediate_snap_threshold = DT_INST_PROP(n, immediate_snap_threshold),                          \
+        .lock_duration_ms = SCROLL_SNAP_INST_LOCK_DURATION_MS(n),                                       \
+        .lock_for_next_n_events = SCROLL_SNAP_INST_LOCK_EVENTS(n),                                      \
+        .idle_reset_timeout_ms = DT_INST_PROP_OR(n, idle_reset_timeout_ms, 0),                          \
+    }
+
+// Window estimators cannot grow past their ring; the EMA only counts samples for readiness
+#define SCROLL_SNAP_INST_SAMPLES_MAX(n)                                                                 \
+    COND_CODE_1(SCROLL_SNAP_INST_IS_EMA(n), (CONFIG_ZMK_SCROLL_SNAP_MAX_BUF_SIZE),                      \
+                (SCROLL_SNAP_INST_RING_SIZE(n)))
+
+#define SCROLL_SNAP_INST_LUT_ENTRY(i, n)                                                                \
+    SCROLL_SNAP_LUT_ENTRY(i, scroll_snap_lut_x_bound_##n, scroll_snap_lut_y_bound_##n,                  \
+                          scroll_snap_lut_xy_low_##n, scroll_snap_lut_xy_high_##n)
+
+// Direction LUT generated from the instance's thresholds
+#define SCROLL_SNAP_INST_LUT(n)                                                                         \
+    enum {                                                                                              \
+        scroll_snap_lut_x_bound_##n = SCROLL_SNAP_LUT_X_BOUND(DT_INST_PROP_BY_IDX(n, x_threshold, 0),   \
+                                                              DT_INST_PROP_BY_IDX(n, x_threshold, 1)),  \
+        scroll_snap_lut_y_bound_##n = SCROLL_SNAP_LUT_Y_BOUND(DT_INST_PROP_BY_IDX(n, y_threshold, 0),   \
+                                                              DT_INST_PROP_BY_IDX(n, y_threshold, 1)),  \
+        scroll_snap_lut_xy_low_##n = SCROLL_SNAP_LUT_XY_LOW(DT_INST_PROP_BY_IDX(n, xy_threshold, 0),    \
+                                                            DT_INST_PROP_BY_IDX(n, xy_threshold, 1)),   \
+        scroll_snap_lut_xy_high_##n = SCROLL_SNAP_LUT_XY_HIGH(DT_INST_PROP_BY_IDX(n, xy_threshold, 0),  \
+                                                              DT_INST_PROP_BY_IDX(n, xy_threshold, 1)), \
+    };                                                                                                  \
+    static const uint8_t input_processor_scroll_snap_lut_##n[SCROLL_SNAP_LUT_SIZE] = {                  \
+        LISTIFY(SCROLL_SNAP_LUT_SIZE, SCROLL_SNAP_INST_LUT_ENTRY, (,), n)};
+
+// Per-instance sample storage
+#define SCROLL_SNAP_INST_RING_STORAGE(n)                                                                \
+    COND_CODE_1(SCROLL_SNAP_INST_IS_EMA(n), (),                                                         \
+                (static scroll_snap_slot_t                                                              \
+                     input_processor_scroll_snap_samples_##n[SCROLL_SNAP_INST_RING_SIZE(n)];))          \
+    COND_CODE_1(SCROLL_SNAP_INST_HAS_SAMPLE_TS(n),                                                      \
+                (static scroll_snap_time_t                                                              \
+                     input_processor_scroll_snap_sample_ts_##n[SCROLL_SNAP_INST_RING_SIZE(n)];),        \
+                ())
+
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_SHARED_STATE)
+#define SCROLL_SNAP_INST_RING_MEMBER(n)                                                                 \
+    COND_CODE_1(SCROLL_SNAP_INST_IS_EMA(n), (),                                                         \
+                (scroll_snap_slot_t samples_##n[SCROLL_SNAP_INST_RING_SIZE(n)];))
+#define SCROLL_SNAP_INST_SAMPLE_TS_MEMBER(n)                                                            \
+    COND_CODE_1(SCROLL_SNAP_INST_HAS_SAMPLE_TS(n),                                                      \
+                (scroll_snap_time_t sample_ts_##n[SCROLL_SNAP_INST_RING_SIZE(n)];), ())
+
+// Sample storage shared by all instances, sized for the largest one
+static union {
+    uint8_t none;
+    DT_INST_FOREACH_STATUS_OKAY(SCROLL_SNAP_INST_RING_MEMBER)
+} scroll_snap_shared_samples;
+
+static union {
+    uint8_t none;
+    DT_INST_FOREACH_STATUS_OKAY(SCROLL_SNAP_INST_SAMPLE_TS_MEMBER)
+} scroll_snap_shared_sample_ts;
+
+#define SCROLL_SNAP_INST_SAMPLES(n) ((scroll_snap_slot_t *)&scroll_snap_shared_samples)
+#define SCROLL_SNAP_INST_SAMPLE_TS(n) ((scroll_snap_time_t *)&scroll_snap_shared_sample_ts)
+#else
+#define SCROLL_SNAP_INST_SAMPLES(n) (input_processor_scroll_snap_samples_##n)
+#define SCROLL_SNAP_INST_SAMPLE_TS(n) (input_processor_scroll_snap_sample_ts_##n)
+#endif
 
 #define SCROLL_SNAP_INPUT_PROCESSOR_INST(n)                                                             \
+    SCROLL_SNAP_INST_CHECK_THRESHOLD(n, x_threshold)                                                    \
+    SCROLL_SNAP_INST_CHECK_THRESHOLD(n, y_threshold)                                                    \
+    SCROLL_SNAP_INST_CHECK_THRESHOLD(n, xy_threshold)                                                   \
+    COND_CODE_1(SCROLL_SNAP_INST_HAS_HYSTERESIS(n),                                                     \
+                (SCROLL_SNAP_INST_CHECK_THRESHOLD(n, hysteresis_threshold)), ())                        \
+    COND_CODE_1(SCROLL_SNAP_INST_HAS_SPECULATIVE(n),                                                    \
+                (SCROLL_SNAP_INST_CHECK_THRESHOLD(n, speculative_threshold)), ())                       \
     static struct input_processor_scroll_snap_data input_processor_scroll_snap_data_##n = {};           \
+    COND_CODE_1(CONFIG_ZMK_SCROLL_SNAP_SHARED_STATE, (), (SCROLL_SNAP_INST_RING_STORAGE(n)))            \
+    COND_CODE_1(SCROLL_SNAP_INST_HAS_LUT(n), (SCROLL_SNAP_INST_LUT(n)), ())                             \
     static const struct input_processor_scroll_snap_config input_processor_scroll_snap_config_##n = {   \
-        .x_thresh_num = DT_INST_PROP_BY_IDX(n, x_threshold, 0),                                         \
-        .x_thresh_den = DT_INST_PROP_BY_IDX(n, x_threshold, 1),                                         \
-        .y_thresh_num = DT_INST_PROP_BY_IDX(n, y_threshold, 0),                                         \
-        .y_thresh_den = DT_INST_PROP_BY_IDX(n, y_threshold, 1),                                         \
-        .xy_thresh_num = DT_INST_PROP_BY_IDX(n, xy_threshold, 0),                                       \
-        .xy_thresh_den = DT_INST_PROP_BY_IDX(n, xy_threshold, 1),                                       \
-        .immediate_snap_threshold = DT_INST_PROP(n, immediate_snap_threshold),                          \
-        .require_n_samples = CLAMP(DT_INST_PROP_OR(n, require_n_samples, 0), 1, CONFIG_ZMK_SCROLL_SNAP_MAX_BUF_SIZE), \
-        .idle_reset_timeout_ms = DT_INST_PROP_OR(n, idle_reset_timeout_ms, 0),                          \
-        .lock_duration_ms = DT_INST_PROP_OR(n, lock_duration_ms, 0),                                    \
-        .lock_for_next_n_events = DT_INST_PROP_OR(n, lock_for_next_n_events, 0),                        \
+        .params = SCROLL_SNAP_INST_PARAMS(n),                                                          \
         .event_type = DT_INST_PROP_OR(n, event_type, INPUT_EV_REL),                                     \
         .event_code_x = DT_INST_PROP_OR(n, event_code_x, INPUT_REL_HWHEEL),                             \
         .event_code_y = DT_INST_PROP_OR(n, event_code_y, INPUT_REL_WHEEL),                              \
-        .track_remainders = DT_INST_PROP_OR(n, track_remainders, false),                                \
+        COND_CODE_1(CONFIG_ZMK_SCROLL_SNAP_RUNTIME_TUNING,                                              \
+                    (.tuning = SCROLL_SNAP_INST_TUNING(n),                                              \
+                     .samples_max = SCROLL_SNAP_INST_SAMPLES_MAX(n),), ())                              \
     };                                                                                                  \
+    COND_CODE_1(CONFIG_ZMK_SCROLL_SNAP_SPECIALIZE_INSTANCES, (SCROLL_SNAP_INST_HANDLER(n)), ())      \
     DEVICE_DT_INST_DEFINE(n, input_processor_scroll_snap_init, NULL,                                    \
                           &input_processor_scroll_snap_data_##n,                                        \
                           &input_processor_scroll_snap_config_##n, POST_KERNEL,                         \
                           CONFIG_KERNEL_INIT_PRIORITY_DEFAULT,                                          \
-                          &input_processor_scroll_snap_driver_api);
+                          COND_CODE_1(CONFIG_ZMK_SCROLL_SNAP_SPECIALIZE_INSTANCES,                      \
+                                      (&input_processor_scroll_snap_driver_api_##n),                    \
+                                      (&input_processor_scroll_snap_driver_api)));
 
 DT_INST_FOREACH_STATUS_OKAY(SCROLL_SNAP_INPUT_PROCESSOR_INST)
 
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_SHELL) || IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_SETTINGS)
+#define SCROLL_SNAP_INST_DEVICE(n) DEVICE_DT_INST_GET(n),
+
+static const struct device *const scroll_snap_devices[] = {
+    DT_INST_FOREACH_STATUS_OKAY(SCROLL_SNAP_INST_DEVICE)};
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_SETTINGS)
+// Called from ZMK's settings_load() once storage is up, for each key under the root. Instances
+// have published their devicetree defaults by then, so a saved set simply replaces them.
+static int scroll_snap_settings_set(const char *name, size_t len, settings_read_cb read_cb,
+                                    void *cb_arg) {
+    const char *next;
+
+    for (size_t i = 0; i < ARRAY_SIZE(scroll_snap_devices); i++) {
+        // Only the instance's own key, not entries below it
+        if (settings_name_steq(name, scroll_snap_devices[i]->name, &next) && next == NULL) {
+            return scroll_snap_settings_apply(scroll_snap_devices[i], len, read_cb, cb_arg);
+        }
+    }
+
+    LOG_WRN("ignoring saved parameters of unknown instance %s", name);
+    return -ENOENT;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(scroll_snap, SCROLL_SNAP_SETTINGS_ROOT, NULL,
+                               scroll_snap_settings_set, NULL, NULL);
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_SCROLL_SNAP_SHELL)
+
+struct scroll_snap_tuning_field {
+    const char *name;
+    uint16_t offset;
+    uint8_t count;
+};
+
+#define SCROLL_SNAP_TUNING_FIELD(_name, member)                                                         \
+    {                                                                                                   \
+        .name = _name,                                                                                  \
+        .offset = offsetof(struct zmk_scroll_snap_tuning, member),                                      \
+        .count = sizeof(((struct zmk_scroll_snap_tuning *)0)->member) / sizeof(uint32_t),               \
+    }
+
+// Named after the devicetree properties
+static const struct scroll_snap_tuning_field scroll_snap_tuning_fields[] = {
+    SCROLL_SNAP_TUNING_FIELD("x-threshold", x_threshold),
+    SCROLL_SNAP_TUNING_FIELD("y-threshold", y_threshold),
+    SCROLL_SNAP_TUNING_FIELD("xy-threshold", xy_threshold),
+    SCROLL_SNAP_TUNING_FIELD("require-n-samples", require_n_samples),
+    SCROLL_SNAP_TUNING_FIELD("immediate-snap-threshold", immediate_snap_threshold),
+    SCROLL_SNAP_TUNING_FIELD("lock-duration-ms", lock_duration_ms),
+    SCROLL_SNAP_TUNING_FIELD("lock-for-next-n-events", lock_for_next_n_events),
+    SCROLL_SNAP_TUNING_FIELD("idle-reset-timeout-ms", idle_reset_timeout_ms),
+};
+
+static const struct device *scroll_snap_shell_device(const struct shell *sh, const char *name) {
+    for (size_t i = 0; i < ARRAY_SIZE(scroll_snap_devices); i++) {
+        if (strcmp(scroll_snap_devices[i]->name, name) == 0) {
+            return scroll_snap_devices[i];
+        }
+    }
+    shell_error(sh, "Unknown scroll snap instance: %s", name);
+    return NULL;
+}
+
+static int cmd_scroll_snap_list(const struct shell *sh, size_t argc, char **argv) {
+    ARG_UNUSED(argc);
+    ARG_UNUSED(argv);
+
+    for (size_t i = 0; i < ARRAY_SIZE(scroll_snap_devices); i++) {
+        shell_print(sh, "%s", scroll_snap_devices[i]->name);
+    }
+    return 0;
+}
+
+static int cmd_scroll_snap_show(const struct shell *sh, size_t argc, char **argv) {
+    const struct device *dev = scroll_snap_shell_device(sh, argv[1]);
+    struct zmk_scroll_snap_tuning tuning;
+
+    ARG_UNUSED(argc);
+    if (dev == NULL) {
+        return -ENODEV;
+    }
+
+    zmk_scroll_snap_get_tuning(dev, &tuning);
+    for (size_t i = 0; i < ARRAY_SIZE(scroll_snap_tuning_fields); i++) {
+        const struct scroll_snap_tuning_field *field = &scroll_snap_tuning_fields[i];
+        const uint32_t *values = (const uint32_t *)((const uint8_t *)&tuning + field->offset);
+
+        if (field->count == 2) {
+            shell_print(sh, "%s = <%u %u>", field->name, values[0], values[1]);
+        } else {
+            shell_print(sh, "%s = <%u>", field->name, values[0]);
+        }
+    }
+    return 0;
+}
+
+static int cmd_scroll_snap_set(const struct shell *sh, size_t argc, char **argv) {
+    const struct device *dev = scroll_snap_shell_device(sh, argv[1]);
+    const struct scroll_snap_tuning_field *field = NULL;
+    struct zmk_scroll_snap_tuning tuning;
+
+    if (dev == NULL) {
+        return -ENODEV;
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(scroll_snap_tuning_fields); i++) {
+        if (strcmp(scroll_snap_tuning_fields[i].name, argv[2]) == 0) {
+            field = &scroll_snap_tuning_fields[i];
+            break;
+        }
+    }
+    if (field == NULL) {
+        shell_error(sh, "Unknown parameter: %s", argv[2]);
+        return -EINVAL;
+    }
+    if (argc - 3 != field->count) {
+        shell_error(sh, "%s takes %u value(s)", field->name, field->count);
+        return -EINVAL;
+    }
+
+    zmk_scroll_snap_get_tuning(dev, &tuning);
+    uint32_t *values = (uint32_t *)((uint8_t *)&tuning + field->offset);
+    for (size_t i = 0; i < field->count; i++) {
+        int err = 0;
+
+        values[i] = shell_strtoul(argv[3 + i], 0, &err);
+        if (err != 0) {
+            shell_error(sh, "Invalid value: %s", argv[3 + i]);
+            return -EINVAL;
+        }
+    }
+
+    int err = zmk_scroll_snap_set_tuning(dev, &tuning);
+    if (err == -ENOTSUP) {
+        shell_error(sh, "%s is fixed by the direction LUT of this instance", field->name);
+    } else if (err < 0) {
+        shell_error(sh, "%s out of range", field->name);
+    }
+    return err;
+}
+
+static int cmd_scroll_snap_reset(const struct shell *sh, size_t argc, char **argv) {
+    const struct device *dev = scroll_snap_shell_device(sh, argv[1]);
+
+    ARG_UNUSED(argc);
+    if (dev == NULL) {
+        return -ENODEV;
+    }
+    return zmk_scroll_snap_reset_tuning(dev);
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(
+    sub_scroll_snap, SHELL_CMD_ARG(list, NULL, "List instances", cmd_scroll_snap_list, 1, 0),
+    SHELL_CMD_ARG(show, NULL, "Show parameters: show <instance>", cmd_scroll_snap_show, 2, 0),
+    SHELL_CMD_ARG(set, NULL, "Set a parameter: set <instance> <property> <value> [<value>]",
+                  cmd_scroll_snap_set, 4, 1),
+    SHELL_CMD_ARG(reset, NULL, "Restore devicetree parameters: reset <instance>",
+                  cmd_scroll_snap_reset, 2, 0),
+    SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(scroll_snap, &sub_scroll_snap, "Scroll snap runtime tuning", NULL);
+#endif
+
 #endif
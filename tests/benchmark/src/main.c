@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <zephyr/device.h>
+#include <zephyr/kernel.h>
+#include <zephyr/input/input.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/timing/timing.h>
+#include <zephyr/ztest.h>
+#include <drivers/input_processor.h>
+#include <scroll_snap/scroll_snap.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+struct trace_event {
+    uint32_t time_ms;
+    int32_t value;
+    uint16_t code;
+    bool sync;
+};
+
+// The trace's line of tools/replay/expected/default.txt
+struct trace_result {
+    uint32_t events;
+    uint32_t emitted;
+    uint32_t zeros;
+    uint32_t first_snap_event;
+    uint32_t first_snap_ms;
+    // Off-axis share of the emitted motion in 0.01%
+    uint32_t leak;
+};
+
+struct trace {
+    const char *name;
+    const struct trace_event *events;
+    size_t len;
+    struct trace_result expected;
+};
+
+#include "scroll_snap_traces.h"
+
+// Longer than idle-reset-timeout-ms, so every trace starts on a reset processor as in the replay
+#define TRACE_GAP_MS 1000
+
+static const char *const bench_path_names[SCROLL_SNAP_PATH_COUNT] = {
+    [SCROLL_SNAP_PATH_IGNORED] = "ignored",
+    [SCROLL_SNAP_PATH_ACCUMULATE] = "accumulate",
+    [SCROLL_SNAP_PATH_DECIDE] = "decide",
+    [SCROLL_SNAP_PATH_LOCKED] = "locked",
+    [SCROLL_SNAP_PATH_FAST] = "fast",
+};
+
+// Cycles per event, sorted by the path the processor reports for it
+static uint32_t bench_cycles[SCROLL_SNAP_PATH_COUNT][TRACE_EVENTS_TOTAL];
+static uint32_t bench_count[SCROLL_SNAP_PATH_COUNT];
+
+static const struct device *const scroll_snap = DEVICE_DT_GET(DT_NODELABEL(scroll_snap_test));
+
+static void bench_record(enum scroll_snap_path path, uint32_t cycles) {
+    if (path != SCROLL_SNAP_PATH_IGNORED && bench_count[path] < TRACE_EVENTS_TOTAL) {
+        bench_cycles[path][bench_count[path]++] = cycles;
+    }
+}
+
+// Feed a trace through the driver at its recorded times and collect the replay tool's figures
+static void replay_trace(const struct trace *trace, struct trace_result *res) {
+    const struct zmk_input_processor_driver_api *api = scroll_snap->api;
+    int64_t base = k_uptime_get() + TRACE_GAP_MS;
+    uint32_t start_ms = trace->events[0].time_ms;
+    uint32_t first_ms = 0;
+    uint64_t in_x = 0, in_y = 0, out_x = 0, out_y = 0;
+
+    memset(res, 0, sizeof(*res));
+
+    for (size_t i = 0; i < trace->len; i++) {
+        const struct trace_event *te = &trace->events[i];
+        struct input_event ev = {
+            .type = INPUT_EV_REL,
+            .code = te->code,
+            .value = te->value,
+            .sync = te->sync,
+        };
+
+        k_sleep(K_TIMEOUT_ABS_MS(base + (te->time_ms - start_ms)));
+
+        int ret = api->handle_event(scroll_snap, &ev, 0, 0, NULL);
+        bool forward = ret == ZMK_INPUT_PROC_CONTINUE;
+        enum scroll_snap_path path;
+        uint32_t cycles;
+
+        zmk_scroll_snap_bench_last(scroll_snap, &path, &cycles);
+        bench_record(path, cycles);
+
+        // As in the replay, events with other codes pass through and are not counted
+        if (te->code != INPUT_REL_HWHEEL && te->code != INPUT_REL_WHEEL) {
+            continue;
+        }
+        if (res->events++ == 0) {
+            first_ms = te->time_ms;
+        }
+        if (te->code == INPUT_REL_HWHEEL) {
+            in_x += abs(te->value);
+        } else {
+            in_y += abs(te->value);
+        }
+
+        if (forward && ev.value != 0) {
+            if (res->first_snap_event == 0) {
+                res->first_snap_event = res->events;
+                res->first_snap_ms = te->time_ms - first_ms;
+            }
+            res->emitted++;
+            if (ev.code == INPUT_REL_HWHEEL) {
+                out_x += abs(ev.value);
+            } else {
+                out_y += abs(ev.value);
+            }
+        } else if (forward) {
+            res->zeros++;
+        }
+    }
+
+    uint64_t off = in_x >= in_y ? out_y : out_x;
+    uint64_t total = out_x + out_y;
+
+    res->leak = total ? (uint32_t)((off * 20000 / total + 1) / 2) : 0;
+}
+
+static int bench_cmp(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+ZTEST(scroll_snap_benchmark, test_replay_traces) {
+    zassert_true(device_is_ready(scroll_snap), "scroll snap processor not ready");
+
+    for (size_t i = 0; i < ARRAY_SIZE(traces); i++) {
+        const struct trace *trace = &traces[i];
+        const struct trace_result *exp = &trace->expected;
+        struct trace_result res;
+
+        replay_trace(trace, &res);
+
+        TC_PRINT("%s: events=%u emitted=%u zeros=%u snap_events=%u snap_ms=%u leak=%u.%02u%%\n",
+                 trace->name, res.events, res.emitted, res.zeros, res.first_snap_event,
+                 res.first_snap_ms, res.leak / 100, res.leak % 100);
+
+        zassert_equal(res.events, exp->events, "%s: %u events, expected %u", trace->name,
+                      res.events, exp->events);
+        zassert_equal(res.emitted, exp->emitted, "%s: %u events emitted, expected %u",
+                      trace->name, res.emitted, exp->emitted);
+        zassert_equal(res.zeros, exp->zeros, "%s: %u zero events forwarded, expected %u",
+                      trace->name, res.zeros, exp->zeros);
+        zassert_equal(res.first_snap_event, exp->first_snap_event,
+                      "%s: snapped at event %u, expected %u", trace->name, res.first_snap_event,
+                      exp->first_snap_event);
+        zassert_equal(res.first_snap_ms, exp->first_snap_ms, "%s: snapped after %u ms, expected %u",
+                      trace->name, res.first_snap_ms, exp->first_snap_ms);
+        // The replay rounds a double, allow for rounding the last digit the other way
+        zassert_within(res.leak, exp->leak, 1, "%s: leakage %u, expected %u (0.01%%)", trace->name,
+                       res.leak, exp->leak);
+    }
+}
+
+ZTEST(scroll_snap_benchmark, test_timing) {
+    zassert_true(device_is_ready(scroll_snap), "scroll snap processor not ready");
+
+    struct trace_result res;
+
+    memset(bench_count, 0, sizeof(bench_count));
+    for (size_t i = 0; i < ARRAY_SIZE(traces); i++) {
+        replay_trace(&traces[i], &res);
+    }
+
+    for (int path = SCROLL_SNAP_PATH_ACCUMULATE; path < SCROLL_SNAP_PATH_COUNT; path++) {
+        uint32_t *cycles = bench_cycles[path];
+        uint32_t n = bench_count[path];
+        uint64_t sum = 0;
+
+        if (n == 0) {
+            continue;
+        }
+
+        qsort(cycles, n, sizeof(cycles[0]), bench_cmp);
+        for (uint32_t i = 0; i < n; i++) {
+            sum += cycles[i];
+        }
+
+        uint32_t avg = (uint32_t)(sum / n);
+
+        TC_PRINT("scroll_snap %s: n=%u min=%u avg=%u p99=%u max=%u cycles, avg %u ns\n",
+                 bench_path_names[path], n, cycles[0], avg, cycles[MIN(n - 1, n * 99 / 100)],
+                 cycles[n - 1], (uint32_t)timing_cycles_to_ns(avg));
+
+        if (CONFIG_SCROLL_SNAP_BENCHMARK_MAX_AVG_CYCLES > 0) {
+            zassert_true(avg <= CONFIG_SCROLL_SNAP_BENCHMARK_MAX_AVG_CYCLES,
+                         "%s path takes %u cycles per event, budget is %u",
+                         bench_path_names[path], avg, CONFIG_SCROLL_SNAP_BENCHMARK_MAX_AVG_CYCLES);
+        }
+    }
+}
+
+static void *scroll_snap_benchmark_setup(void) {
+    timing_init();
+    timing_start();
+
+    return NULL;
+}
+
+static void scroll_snap_benchmark_teardown(void *fixture) {
+    ARG_UNUSED(fixture);
+
+    timing_stop();
+}
+
+ZTEST_SUITE(scroll_snap_benchmark, NULL, scroll_snap_benchmark_setup, NULL, NULL,
+            scroll_snap_benchmark_teardown);
@@ -0,0 +1,41 @@
+# Copyright (c) 2024 The ZMK Contributors
+# SPDX-License-Identifier: MIT
+
+# Runs one replay case and compares its report with the expected output, see CMakeLists.txt.
+string(REPLACE "|" ";" args "${ARGS}")
+execute_process(COMMAND ${TOOL} ${args}
+                OUTPUT_VARIABLE actual
+                ERROR_VARIABLE error
+                RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "replay failed (${result}):\n${error}")
+endif()
+
+if(DEFINED MATCH_ARGS)
+  string(REPLACE "|" ";" match_args "${MATCH_ARGS}")
+  execute_process(COMMAND ${TOOL} ${match_args}
+                  OUTPUT_VARIABLE expected
+                  ERROR_VARIABLE error
+                  RESULT_VARIABLE result)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "reference replay failed (${result}):\n${error}")
+  endif()
+  set(EXPECTED ${ACTUAL}.reference)
+  file(WRITE ${EXPECTED} "${expected}")
+elseif(DEFINED ENV{SCROLL_SNAP_REPLAY_UPDATE})
+  file(WRITE ${EXPECTED} "${actual}")
+  return()
+endif()
+
+if(NOT EXISTS ${EXPECTED})
+  message(FATAL_ERROR "missing ${EXPECTED}, run with SCROLL_SNAP_REPLAY_UPDATE=1 to create it")
+endif()
+file(READ ${EXPECTED} expected)
+if(NOT actual STREQUAL expected)
+  file(WRITE ${ACTUAL} "${actual}")
+  find_program(DIFF diff)
+  if(DIFF)
+    execute_process(COMMAND ${DIFF} -u ${EXPECTED} ${ACTUAL})
+  endif()
+  message(FATAL_ERROR "report differs from ${EXPECTED}, actual output in ${ACTUAL}")
+endif()
@@ -0,0 +1,629 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Host-side replay of recorded REL event traces through the scroll snap decision core.
+ *
+ *   cc -O2 -Wall -Iinclude -o scroll_snap_replay tools/replay/scroll_snap_replay.c
+ *
+ * Build options of the firmware (e.g. -DCONFIG_ZMK_SCROLL_SNAP_ACCUMULATOR_16BIT) can be passed
+ * with -D to replay exactly what a given configuration does. See README.md for the trace format.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <scroll_snap/scroll_snap_core.h>
+
+#define REPLAY_MAX_SAMPLES SCROLL_SNAP_SAMPLES_MAX
+#define REPLAY_LINE_MAX 256
+
+// Linux input event codes, as used by the devicetree defaults and presets
+#define REPLAY_REL_X 0x00
+#define REPLAY_REL_Y 0x01
+#define REPLAY_REL_HWHEEL 0x06
+#define REPLAY_REL_WHEEL 0x08
+
+// Instance configuration in devicetree units
+struct replay_config {
+    uint32_t x_threshold[2];
+    uint32_t y_threshold[2];
+    uint32_t xy_threshold[2];
+    uint32_t hysteresis_threshold[2];
+    uint32_t speculative_threshold[2];
+    uint32_t require_n_samples;
+    uint32_t immediate_snap_threshold;
+    uint32_t velocity_fast;
+    uint32_t velocity_fast_samples;
+    uint32_t velocity_fast_threshold_scale;
+    uint32_t lock_duration_ms;
+    uint32_t lock_for_next_n_events;
+    uint32_t idle_reset_timeout_ms;
+    uint32_t sample_window_ms;
+    uint8_t estimator;
+    uint32_t ema_window;
+    bool classifier_lut;
+    bool coalesce_frames;
+    bool frames;
+    bool suppress_zero_events;
+    bool track_remainders;
+    bool lock_fast_path;
+    uint32_t output_step;
+    uint16_t event_code_x;
+    uint16_t event_code_y;
+    // Added to every trace time, to replay across a 32-bit tick boundary
+    uint32_t time_offset;
+};
+
+struct replay_result {
+    uint32_t events;
+    uint32_t ignored;
+    // 1-based index and offset of the first event forwarded with a non-zero value, 0 if none
+    uint32_t first_snap_event;
+    uint32_t first_snap_ms;
+    // Events, or frames with --frames, forwarded with a non-zero value, and forwarded with zero
+    uint32_t emitted;
+    uint32_t zeros;
+    uint64_t in_x;
+    uint64_t in_y;
+    uint64_t out_x;
+    uint64_t out_y;
+    uint32_t flips;
+};
+
+struct replay_preset {
+    const char *name;
+    uint32_t x_threshold[2];
+    uint32_t y_threshold[2];
+    uint32_t xy_threshold[2];
+    uint16_t event_code_x;
+    uint16_t event_code_y;
+};
+
+// The predefined instances of dts/scroll-snap.dtsi
+static const struct replay_preset presets[] = {
+    {"scroll", {5, 8}, {1, 1}, {0, 0}, REPLAY_REL_HWHEEL, REPLAY_REL_WHEEL},
+    {"scroll-8way", {5, 8}, {8, 5}, {5, 8}, REPLAY_REL_HWHEEL, REPLAY_REL_WHEEL},
+    {"cursor", {1, 1}, {1, 1}, {0, 0}, REPLAY_REL_X, REPLAY_REL_Y},
+    {"cursor-8way", {5, 8}, {8, 5}, {5, 8}, REPLAY_REL_X, REPLAY_REL_Y},
+};
+
+static void replay_apply_preset(struct replay_config *cfg, const struct replay_preset *preset) {
+    memcpy(cfg->x_threshold, preset->x_threshold, sizeof(cfg->x_threshold));
+    memcpy(cfg->y_threshold, preset->y_threshold, sizeof(cfg->y_threshold));
+    memcpy(cfg->xy_threshold, preset->xy_threshold, sizeof(cfg->xy_threshold));
+    cfg->event_code_x = preset->event_code_x;
+    cfg->event_code_y = preset->event_code_y;
+}
+
+static int replay_parse_u32(const char *arg, uint32_t *out) {
+    char *end;
+
+    errno = 0;
+    unsigned long value = strtoul(arg, &end, 0);
+    if (errno != 0 || end == arg || *end != '\0' || value > UINT32_MAX) {
+        return -EINVAL;
+    }
+    *out = (uint32_t)value;
+    return 0;
+}
+
+static int replay_parse_ratio(const char *arg, uint32_t ratio[2]) {
+    char buf[32];
+    char *slash;
+
+    if (strlen(arg) >= sizeof(buf)) {
+        return -EINVAL;
+    }
+    strcpy(buf, arg);
+    slash = strchr(buf, '/');
+    if (slash == NULL) {
+        return -EINVAL;
+    }
+    *slash = '\0';
+    if (replay_parse_u32(buf, &ratio[0]) < 0 || replay_parse_u32(slash + 1, &ratio[1]) < 0) {
+        return -EINVAL;
+    }
+    return 0;
+}
+
+// Property accessors of SCROLL_SNAP_PARAMS_INIT(); the trace time base is milliseconds
+#define REPLAY_PROP(cfg, prop) ((cfg)->prop)
+#define REPLAY_PROP_IDX(cfg, prop, idx) ((cfg)->prop[idx])
+#define REPLAY_MS_TO_TICKS(ms) (ms)
+
+static void replay_params_init(struct scroll_snap_params *params, const struct replay_config *cfg,
+                               scroll_snap_slot_t *samples, scroll_snap_time_t *sample_ts,
+                               uint8_t *lut) {
+    *params = (struct scroll_snap_params)SCROLL_SNAP_PARAMS_INIT(
+        REPLAY_PROP, REPLAY_PROP_IDX, cfg, cfg->estimator == SCROLL_SNAP_ESTIMATOR_EMA,
+        REPLAY_MAX_SAMPLES, REPLAY_MS_TO_TICKS, samples, sample_ts, cfg->classifier_lut ? lut : NULL,
+        cfg->lock_fast_path);
+
+    if (cfg->classifier_lut) {
+        int32_t x_bound = SCROLL_SNAP_LUT_X_BOUND(cfg->x_threshold[0], cfg->x_threshold[1]);
+        int32_t y_bound = SCROLL_SNAP_LUT_Y_BOUND(cfg->y_threshold[0], cfg->y_threshold[1]);
+        int32_t xy_low = SCROLL_SNAP_LUT_XY_LOW(cfg->xy_threshold[0], cfg->xy_threshold[1]);
+        int32_t xy_high = SCROLL_SNAP_LUT_XY_HIGH(cfg->xy_threshold[0], cfg->xy_threshold[1]);
+
+        for (int i = 0; i < SCROLL_SNAP_LUT_SIZE; i++) {
+            lut[i] = SCROLL_SNAP_LUT_ENTRY(i, x_bound, y_bound, xy_low, xy_high);
+        }
+    }
+}
+
+// Parse "<time_ms> <axis> <value> [sync]"; axis is x, y or a numeric event code.
+// Returns 1 for an event, 0 for a blank or comment line, -EINVAL on malformed input.
+static int replay_parse_line(const char *line, const struct replay_config *cfg, uint32_t *time_ms,
+                             int *axis, int32_t *value, bool *sync) {
+    char axis_str[16];
+    char sync_str[16] = "";
+    unsigned long t;
+    long v;
+
+    while (*line == ' ' || *line == '\t') {
+        line++;
+    }
+    if (*line == '\0' || *line == '\n' || *line == '#') {
+        return 0;
+    }
+
+    if (sscanf(line, "%lu %15s %ld %15s", &t, axis_str, &v, sync_str) < 3) {
+        return -EINVAL;
+    }
+
+    if (strcmp(axis_str, "x") == 0) {
+        *axis = 'x';
+    } else if (strcmp(axis_str, "y") == 0) {
+        *axis = 'y';
+    } else {
+        uint32_t code;
+        if (replay_parse_u32(axis_str, &code) < 0) {
+            return -EINVAL;
+        }
+        *axis = code == cfg->event_code_x ? 'x' : code == cfg->event_code_y ? 'y' : 0;
+    }
+
+    *time_ms = (uint32_t)t;
+    *value = (int32_t)v;
+    *sync = strcmp(sync_str, "1") == 0 || strcmp(sync_str, "s") == 0 || strcmp(sync_str, "sync") == 0;
+    return 1;
+}
+
+static int replay_trace(FILE *fp, const char *name, const struct replay_config *cfg,
+                        struct replay_result *res) {
+    static scroll_snap_slot_t samples[SCROLL_SNAP_RING_SIZE(REPLAY_MAX_SAMPLES)];
+    static scroll_snap_time_t sample_ts[SCROLL_SNAP_RING_SIZE(REPLAY_MAX_SAMPLES)];
+    static uint8_t lut[SCROLL_SNAP_LUT_SIZE];
+    struct scroll_snap_params params;
+    struct scroll_snap_core core;
+    char line[REPLAY_LINE_MAX];
+    uint32_t first_ms = 0;
+    uint8_t last_lock = DIRECTION_NONE;
+    unsigned int lineno = 0;
+    int32_t frame_x = 0, frame_y = 0;
+
+    replay_params_init(&params, cfg, samples, sample_ts, lut);
+    memset(&core, 0, sizeof(core));
+    memset(res, 0, sizeof(*res));
+    scroll_snap_core_reset(&core);
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        uint32_t time_ms;
+        int axis;
+        int32_t value;
+        bool sync;
+
+        lineno++;
+        int ret = replay_parse_line(line, cfg, &time_ms, &axis, &value, &sync);
+        if (ret < 0) {
+            fprintf(stderr, "%s:%u: malformed event\n", name, lineno);
+            return ret;
+        }
+        if (ret == 0) {
+            continue;
+        }
+        if (axis == 0) {
+            res->ignored++;
+            continue;
+        }
+
+        if (res->events == 0) {
+            first_ms = time_ms;
+            core.last_event_ts = (scroll_snap_time_t)cfg->time_offset + time_ms;
+        }
+        res->events++;
+
+        if (axis == 'x') {
+            res->in_x += (uint64_t)llabs(value);
+        } else {
+            res->in_y += (uint64_t)llabs(value);
+        }
+
+        // Expiry is applied lazily, as without CONFIG_ZMK_SCROLL_SNAP_TIMER_EXPIRY
+        scroll_snap_time_t now =
+            params.uses_time ? (scroll_snap_time_t)cfg->time_offset + time_ms : 0;
+        enum scroll_snap_path path;
+        int32_t out_x = 0, out_y = 0;
+        bool forward;
+
+        if (cfg->frames) {
+            // Collect the deltas of a report and hand them over at its sync event, as
+            // zmk_scroll_snap_process_burst() does
+            if (axis == 'x') {
+                frame_x += value;
+            } else {
+                frame_y += value;
+            }
+            if (!sync) {
+                continue;
+            }
+            if (params.idle_reset_timeout > 0 || params.lock_duration > 0) {
+                scroll_snap_core_expire(&core, &params, now);
+            }
+            forward = scroll_snap_core_process_frame(&core, &params, &frame_x, &frame_y, now, &path);
+            out_x = frame_x;
+            out_y = frame_y;
+            frame_x = 0;
+            frame_y = 0;
+        } else {
+            if (params.idle_reset_timeout > 0 || params.lock_duration > 0) {
+                scroll_snap_core_expire(&core, &params, now);
+            }
+
+            struct scroll_snap_event ev = {.value = value, .is_x_axis = axis == 'x', .sync = sync};
+            forward = scroll_snap_core_process(&core, &params, &ev, now, &path);
+            if (ev.is_x_axis) {
+                out_x = ev.value;
+            } else {
+                out_y = ev.value;
+            }
+        }
+
+        if (forward && (out_x != 0 || out_y != 0)) {
+            if (res->first_snap_event == 0) {
+                res->first_snap_event = res->events;
+                res->first_snap_ms = time_ms - first_ms;
+            }
+            res->emitted++;
+            res->out_x += (uint64_t)llabs(out_x);
+            res->out_y += (uint64_t)llabs(out_y);
+        } else if (forward) {
+            res->zeros++;
+        }
+
+        // A flip is a lock taken in a different direction than the previous one
+        if (core.lock_direction != DIRECTION_NONE) {
+            if (last_lock != DIRECTION_NONE && core.lock_direction != last_lock) {
+                res->flips++;
+            }
+            last_lock = core.lock_direction;
+        }
+    }
+
+    return ferror(fp) ? -EIO : 0;
+}
+
+// Emitted motion on the axis the trace moved less on, as a share of all emitted motion
+static double replay_leakage(const struct replay_result *res) {
+    uint64_t off = res->in_x >= res->in_y ? res->out_y : res->out_x;
+    uint64_t total = res->out_x + res->out_y;
+
+    return total ? 100.0 * (double)off / (double)total : 0.0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [options] trace...\n"
+            "\n"
+            "Replays REL event traces (\"-\" for stdin) through the scroll snap core and reports\n"
+            "decision latency, off-axis leakage and lock flips per trace.\n"
+            "\n"
+            "  --preset NAME                   scroll (default), scroll-8way, cursor, cursor-8way\n"
+            "  --x-threshold N/D\n"
+            "  --y-threshold N/D\n"
+            "  --xy-threshold N/D\n"
+            "  --hysteresis-threshold N/D      replaces the lock timers\n"
+            "  --require-n-samples N           (10)\n"
+            "  --immediate-snap-threshold N    (1500)\n"
+            "  --speculative-threshold N/D     emit on the dominant axis while collecting samples\n"
+            "  --velocity-fast N               (0)\n"
+            "  --velocity-fast-samples N       (1)\n"
+            "  --velocity-fast-threshold-scale N (200)\n"
+            "  --lock-duration-ms N            (200)\n"
+            "  --lock-for-next-n-events N      (10)\n"
+            "  --idle-reset-timeout-ms N       (200)\n"
+            "  --sample-window-ms N            (0)\n"
+            "  --estimator window|ema\n"
+            "  --classifier thresholds|lut\n"
+            "  --ema-window N\n"
+            "  --coalesce-frames\n"
+            "  --frames                        feed each report as one frame, as the burst API\n"
+            "  --suppress-zero-events\n"
+            "  --no-track-remainders\n"
+            "  --output-step N                 (0)\n"
+            "  --lock-fast-path                as CONFIG_ZMK_SCROLL_SNAP_LOCK_FAST_PATH=y\n"
+            "  --event-code-x N, --event-code-y N\n"
+            "  --time-offset N                 add N ms to every trace time\n"
+            "  --quiet                         print the summary line only\n",
+            prog);
+}
+
+enum {
+    OPT_PRESET = 256,
+    OPT_X_THRESHOLD,
+    OPT_Y_THRESHOLD,
+    OPT_XY_THRESHOLD,
+    OPT_HYSTERESIS_THRESHOLD,
+    OPT_REQUIRE_N_SAMPLES,
+    OPT_IMMEDIATE_SNAP_THRESHOLD,
+    OPT_SPECULATIVE_THRESHOLD,
+    OPT_VELOCITY_FAST,
+    OPT_VELOCITY_FAST_SAMPLES,
+    OPT_VELOCITY_FAST_THRESHOLD_SCALE,
+    OPT_LOCK_DURATION_MS,
+    OPT_LOCK_FOR_NEXT_N_EVENTS,
+    OPT_IDLE_RESET_TIMEOUT_MS,
+    OPT_SAMPLE_WINDOW_MS,
+    OPT_ESTIMATOR,
+    OPT_CLASSIFIER,
+    OPT_EMA_WINDOW,
+    OPT_COALESCE_FRAMES,
+    OPT_FRAMES,
+    OPT_SUPPRESS_ZERO_EVENTS,
+    OPT_NO_TRACK_REMAINDERS,
+    OPT_OUTPUT_STEP,
+    OPT_LOCK_FAST_PATH,
+    OPT_EVENT_CODE_X,
+    OPT_EVENT_CODE_Y,
+    OPT_TIME_OFFSET,
+    OPT_QUIET,
+};
+
+static const struct option long_options[] = {
+    {"preset", required_argument, NULL, OPT_PRESET},
+    {"x-threshold", required_argument, NULL, OPT_X_THRESHOLD},
+    {"y-threshold", required_argument, NULL, OPT_Y_THRESHOLD},
+    {"xy-threshold", required_argument, NULL, OPT_XY_THRESHOLD},
+    {"hysteresis-threshold", required_argument, NULL, OPT_HYSTERESIS_THRESHOLD},
+    {"require-n-samples", required_argument, NULL, OPT_REQUIRE_N_SAMPLES},
+    {"immediate-snap-threshold", required_argument, NULL, OPT_IMMEDIATE_SNAP_THRESHOLD},
+    {"speculative-threshold", required_argument, NULL, OPT_SPECULATIVE_THRESHOLD},
+    {"velocity-fast", required_argument, NULL, OPT_VELOCITY_FAST},
+    {"velocity-fast-samples", required_argument, NULL, OPT_VELOCITY_FAST_SAMPLES},
+    {"velocity-fast-threshold-scale", required_argument, NULL, OPT_VELOCITY_FAST_THRESHOLD_SCALE},
+    {"lock-duration-ms", required_argument, NULL, OPT_LOCK_DURATION_MS},
+    {"lock-for-next-n-events", required_argument, NULL, OPT_LOCK_FOR_NEXT_N_EVENTS},
+    {"idle-reset-timeout-ms", required_argument, NULL, OPT_IDLE_RESET_TIMEOUT_MS},
+    {"sample-window-ms", required_argument, NULL, OPT_SAMPLE_WINDOW_MS},
+    {"estimator", required_argument, NULL, OPT_ESTIMATOR},
+    {"classifier", required_argument, NULL, OPT_CLASSIFIER},
+    {"ema-window", required_argument, NULL, OPT_EMA_WINDOW},
+    {"coalesce-frames", no_argument, NULL, OPT_COALESCE_FRAMES},
+    {"frames", no_argument, NULL, OPT_FRAMES},
+    {"suppress-zero-events", no_argument, NULL, OPT_SUPPRESS_ZERO_EVENTS},
+    {"no-track-remainders", no_argument, NULL, OPT_NO_TRACK_REMAINDERS},
+    {"output-step", required_argument, NULL, OPT_OUTPUT_STEP},
+    {"lock-fast-path", no_argument, NULL, OPT_LOCK_FAST_PATH},
+    {"event-code-x", required_argument, NULL, OPT_EVENT_CODE_X},
+    {"event-code-y", required_argument, NULL, OPT_EVENT_CODE_Y},
+    {"time-offset", required_argument, NULL, OPT_TIME_OFFSET},
+    {"quiet", no_argument, NULL, OPT_QUIET},
+    {"help", no_argument, NULL, 'h'},
+    {NULL, 0, NULL, 0},
+};
+
+static int replay_parse_option(struct replay_config *cfg, int opt, const char *arg, bool *quiet) {
+    uint32_t value = 0;
+
+    switch (opt) {
+        case OPT_PRESET:
+            for (size_t i = 0; i < sizeof(presets) / sizeof(presets[0]); i++) {
+                if (strcmp(arg, presets[i].name) == 0) {
+                    replay_apply_preset(cfg, &presets[i]);
+                    return 0;
+                }
+            }
+            return -EINVAL;
+        case OPT_X_THRESHOLD:
+            return replay_parse_ratio(arg, cfg->x_threshold);
+        case OPT_Y_THRESHOLD:
+            return replay_parse_ratio(arg, cfg->y_threshold);
+        case OPT_XY_THRESHOLD:
+            return replay_parse_ratio(arg, cfg->xy_threshold);
+        case OPT_HYSTERESIS_THRESHOLD:
+            return replay_parse_ratio(arg, cfg->hysteresis_threshold);
+        case OPT_SPECULATIVE_THRESHOLD:
+            return replay_parse_ratio(arg, cfg->speculative_threshold);
+        case OPT_ESTIMATOR:
+            if (strcmp(arg, "window") == 0) {
+                cfg->estimator = SCROLL_SNAP_ESTIMATOR_WINDOW;
+            } else if (strcmp(arg, "ema") == 0) {
+                cfg->estimator = SCROLL_SNAP_ESTIMATOR_EMA;
+            } else {
+                return -EINVAL;
+            }
+            return 0;
+        case OPT_CLASSIFIER:
+            if (strcmp(arg, "thresholds") == 0) {
+                cfg->classifier_lut = false;
+            } else if (strcmp(arg, "lut") == 0) {
+                cfg->classifier_lut = true;
+            } else {
+                return -EINVAL;
+            }
+            return 0;
+        case OPT_COALESCE_FRAMES:
+            cfg->coalesce_frames = true;
+            return 0;
+        case OPT_FRAMES:
+            cfg->frames = true;
+            return 0;
+        case OPT_SUPPRESS_ZERO_EVENTS:
+            cfg->suppress_zero_events = true;
+            return 0;
+        case OPT_NO_TRACK_REMAINDERS:
+            cfg->track_remainders = false;
+            return 0;
+        case OPT_LOCK_FAST_PATH:
+            cfg->lock_fast_path = true;
+            return 0;
+        case OPT_QUIET:
+            *quiet = true;
+            return 0;
+        default:
+            break;
+    }
+
+    if (replay_parse_u32(arg, &value) < 0) {
+        return -EINVAL;
+    }
+
+    switch (opt) {
+        case OPT_REQUIRE_N_SAMPLES:
+            cfg->require_n_samples = value;
+            break;
+        case OPT_IMMEDIATE_SNAP_THRESHOLD:
+            cfg->immediate_snap_threshold = value;
+            break;
+        case OPT_OUTPUT_STEP:
+            cfg->output_step = value;
+            break;
+        case OPT_VELOCITY_FAST:
+            cfg->velocity_fast = value;
+            break;
+        case OPT_VELOCITY_FAST_SAMPLES:
+            cfg->velocity_fast_samples = value;
+            break;
+        case OPT_VELOCITY_FAST_THRESHOLD_SCALE:
+            cfg->velocity_fast_threshold_scale = value;
+            break;
+        case OPT_LOCK_DURATION_MS:
+            cfg->lock_duration_ms = value;
+            break;
+        case OPT_LOCK_FOR_NEXT_N_EVENTS:
+            cfg->lock_for_next_n_events = value;
+            break;
+        case OPT_IDLE_RESET_TIMEOUT_MS:
+            cfg->idle_reset_timeout_ms = value;
+            break;
+        case OPT_SAMPLE_WINDOW_MS:
+            cfg->sample_window_ms = value;
+            break;
+        case OPT_EMA_WINDOW:
+            cfg->ema_window = value;
+            break;
+        case OPT_EVENT_CODE_X:
+            cfg->event_code_x = value;
+            break;
+        case OPT_EVENT_CODE_Y:
+            cfg->event_code_y = value;
+            break;
+        case OPT_TIME_OFFSET:
+            cfg->time_offset = value;
+            break;
+        default:
+            return -EINVAL;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    struct replay_config cfg = {
+        .require_n_samples = 10,
+        .immediate_snap_threshold = 1500,
+        .velocity_fast_samples = 1,
+        .velocity_fast_threshold_scale = 200,
+        .lock_duration_ms = 200,
+        .lock_for_next_n_events = 10,
+        .idle_reset_timeout_ms = 200,
+        .estimator = SCROLL_SNAP_ESTIMATOR_WINDOW,
+        .track_remainders = true,
+    };
+    bool quiet = false;
+    int opt;
+
+    replay_apply_preset(&cfg, &presets[0]);
+
+    while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+        if (opt == 'h') {
+            usage(argv[0]);
+            return 0;
+        }
+        if (opt == '?' || replay_parse_option(&cfg, opt, optarg, &quiet) < 0) {
+            if (opt != '?') {
+                fprintf(stderr, "%s: invalid argument '%s'\n", argv[0], optarg);
+            }
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    uint32_t traces = 0, snapped = 0, flips = 0, emitted = 0, zeros = 0;
+    uint64_t snap_events = 0, snap_ms = 0, out_on = 0, out_off = 0;
+
+    if (!quiet) {
+        printf("%-40s %8s %8s %8s %11s %9s %8s %6s\n", "trace", "events", "emitted", "zeros",
+               "snap_events", "snap_ms", "leak_%", "flips");
+    }
+
+    for (int i = optind; i < argc; i++) {
+        const char *name = argv[i];
+        FILE *fp = strcmp(name, "-") == 0 ? stdin : fopen(name, "r");
+        struct replay_result res;
+
+        if (fp == NULL) {
+            fprintf(stderr, "%s: %s\n", name, strerror(errno));
+            return 1;
+        }
+        int ret = replay_trace(fp, name, &cfg, &res);
+        if (fp != stdin) {
+            fclose(fp);
+        }
+        if (ret < 0) {
+            return 1;
+        }
+
+        traces++;
+        flips += res.flips;
+        emitted += res.emitted;
+        zeros += res.zeros;
+        if (res.first_snap_event > 0) {
+            snapped++;
+            snap_events += res.first_snap_event;
+            snap_ms += res.first_snap_ms;
+        }
+        out_on += res.in_x >= res.in_y ? res.out_x : res.out_y;
+        out_off += res.in_x >= res.in_y ? res.out_y : res.out_x;
+
+        if (quiet) {
+            continue;
+        }
+        if (res.first_snap_event > 0) {
+            printf("%-40s %8u %8u %8u %11u %9u %8.2f %6u\n", name, res.events, res.emitted,
+                   res.zeros, res.first_snap_event, res.first_snap_ms, replay_leakage(&res),
+                   res.flips);
+        } else {
+            printf("%-40s %8u %8u %8u %11s %9s %8.2f %6u\n", name, res.events, res.emitted,
+                   res.zeros, "-", "-", replay_leakage(&res), res.flips);
+        }
+    }
+
+    printf("summary: traces=%u snapped=%u emitted=%u zeros=%u mean_snap_events=%.2f "
+           "mean_snap_ms=%.2f leak_%%=%.2f flips=%u\n",
+           traces, snapped, emitted, zeros, snapped ? (double)snap_events / snapped : 0.0,
+           snapped ? (double)snap_ms / snapped : 0.0,
+           out_on + out_off ? 100.0 * (double)out_off / (double)(out_on + out_off) : 0.0, flips);
+
+    return 0;
+}